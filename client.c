@@ -0,0 +1,669 @@
+/*
+ * OPERATING SYSTEMS DESING - 16/17
+ *
+ * @file 	client.c
+ * @brief 	Implementation of the core file system funcionalities as a client of the file system server (server.c).
+ * @date	01/03/2017
+ */
+
+#define _GNU_SOURCE			// Necesario para memfd_create
+#include "include/filesystem.h"		// Headers for the core functionality
+#include "include/client.h"		// Headers for the client of the server
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+static int socketServidor= -1;		// Socket conectado al servidor. -1 si no hay conexión.
+static char* memoriaCompartida;		// Memoria compartida con el servidor. NULL si no se ha podido crear.
+static uint32_t siguienteId;		// Identificador de la siguiente petición
+static char nombreEstado[MAX_DATOS_PETICION];	// Nombre devuelto por statFile. Es válido hasta la siguiente llamada.
+static char bufferRespuesta[MAX_DATOS_PETICION];	// Datos de las respuestas
+
+/*
+ * @brief 	Envía length bytes por el socket, aunque la llamada se interrumpa o se envíen por partes.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+static int sendAll(const void* buffer, size_t longitud){
+	const char* datos= (const char*) buffer;
+	while(longitud>0){
+		ssize_t enviados= send(socketServidor, datos, longitud, MSG_NOSIGNAL);
+		if(enviados<0 && errno==EINTR){
+			continue;
+		}
+		if(enviados<=0){
+			return -1;
+		}
+		datos+= enviados;
+		longitud-= enviados;
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Recibe exactamente length bytes del socket. Si buffer es NULL se descartan.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+static int receiveAll(void* buffer, size_t longitud){
+	char descarte[256];
+	char* datos= (char*) buffer;
+	while(longitud>0){
+		char* destino= datos!=NULL ? datos : descarte;
+		size_t aRecibir= datos!=NULL || longitud<sizeof(descarte) ? longitud : sizeof(descarte);
+		ssize_t recibidos= recv(socketServidor, destino, aRecibir, 0);
+		if(recibidos<0 && errno==EINTR){
+			continue;
+		}
+		if(recibidos<=0){
+			return -1;
+		}
+		if(datos!=NULL){
+			datos+= recibidos;
+		}
+		longitud-= recibidos;
+	}
+	return 0;
+}
+
+/*
+ * @brief	Sends a request without waiting for its response, so that several requests can be in flight at once.
+ * @return	The id of the request, -1 in case of error.
+ */
+long submitRequest(Peticion *request, const void *data)
+{
+	if(socketServidor<0 || request==NULL || request->longitudDatos>MAX_DATOS_PETICION){
+		return -1;
+	}
+	request->id= siguienteId++;
+	if(sendAll(request, sizeof(Peticion))<0 || sendAll(data, request->longitudDatos)<0){
+		return -1;
+	}
+	return request->id;
+}
+
+/*
+ * @brief	Waits for the response to the oldest request in flight.
+ * @return	0 if success, -1 in case of error.
+ */
+int waitResponse(Respuesta *response, void *data, int size)
+{
+	if(socketServidor<0 || response==NULL || receiveAll(response, sizeof(Respuesta))<0){
+		return -1;
+	}
+	uint32_t aCopiar= response->longitudDatos<(uint32_t) size ? response->longitudDatos : (uint32_t) (size>0 ? size : 0);
+	if(receiveAll(data, aCopiar)<0 || receiveAll(NULL, response->longitudDatos-aCopiar)<0){
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * @brief	Gets the memory shared with the server.
+ * @return	Pointer to the shared memory and its size in <size>, NULL if there is no shared memory.
+ */
+char *getSharedMemory(int *size)
+{
+	if(size!=NULL){
+		*size= memoriaCompartida!=NULL ? TAM_MEMORIA_COMPARTIDA : 0;
+	}
+	return memoriaCompartida;
+}
+
+/*
+ * @brief 	Envía una petición y espera su respuesta. Los datos de la respuesta se dejan en bufferRespuesta.
+ * @return 	Resultado de la operación, error si no se puede comunicar con el servidor.
+ */
+static int callServer(Peticion* peticion, const void* datos, int error, uint32_t* longitudRespuesta){
+	Respuesta respuesta;
+	if(submitRequest(peticion, datos)<0 || waitResponse(&respuesta, bufferRespuesta, sizeof(bufferRespuesta))<0){
+		return error;
+	}
+	if(longitudRespuesta!=NULL){
+		*longitudRespuesta= respuesta.longitudDatos<sizeof(bufferRespuesta) ? respuesta.longitudDatos : sizeof(bufferRespuesta);
+	}
+	return respuesta.resultado;
+}
+
+/*
+ * @brief 	Envía una operación cuyo único dato es un nombre de fichero.
+ * @return 	Resultado de la operación, error si no se puede comunicar con el servidor.
+ */
+static int callWithName(int operacion, const char* nombre, int error, uint32_t* longitudRespuesta){
+	if(nombre==NULL){
+		nombre= "";
+	}
+	Peticion peticion;
+	memset(&peticion, 0, sizeof(peticion));
+	peticion.operacion= operacion;
+	peticion.longitudDatos= strlen(nombre)+1;
+	if(peticion.longitudDatos>MAX_DATOS_PETICION){
+		return error;
+	}
+	return callServer(&peticion, nombre, error, longitudRespuesta);
+}
+
+/*
+ * @brief 	Envía una operación sobre un descriptor de fichero.
+ * @return 	Resultado de la operación, error si no se puede comunicar con el servidor.
+ */
+static int callWithDescriptor(int operacion, int fd, int parametro, long desplazamiento, int error){
+	Peticion peticion;
+	memset(&peticion, 0, sizeof(peticion));
+	peticion.operacion= operacion;
+	peticion.descriptor= fd;
+	peticion.parametro= parametro;
+	peticion.desplazamiento= desplazamiento;
+	return callServer(&peticion, NULL, error, NULL);
+}
+
+/*
+ * @brief	Connects to the file system server listening on <socketPath>.
+ * @return	0 if success, -1 otherwise.
+ */
+int connectFS(const char *socketPath)
+{
+	if(socketServidor>=0 || socketPath==NULL){
+		return -1;
+	}
+	struct sockaddr_un direccion;
+	memset(&direccion, 0, sizeof(direccion));
+	direccion.sun_family= AF_UNIX;
+	if(strlen(socketPath)>=sizeof(direccion.sun_path)){
+		return -1;
+	}
+	strcpy(direccion.sun_path, socketPath);
+	socketServidor= socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+	if(socketServidor<0){
+		return -1;
+	}
+	if(connect(socketServidor, (struct sockaddr*) &direccion, sizeof(direccion))<0){
+		close(socketServidor);
+		socketServidor= -1;
+		return -1;
+	}
+
+	/* Creación de la memoria compartida y entrega de su descriptor al servidor con SCM_RIGHTS. Si no se puede crear todos los
+	   datos se transfieren por el socket. */
+	int fdMemoria= memfd_create("filesystem", MFD_CLOEXEC|MFD_ALLOW_SEALING);
+	if(fdMemoria<0){
+		return 0;
+	}
+
+	/* El servidor sólo acepta la memoria sellada contra la reducción de tamaño, que le provocaría SIGBUS al acceder a ella */
+	if(ftruncate(fdMemoria, TAM_MEMORIA_COMPARTIDA)<0 || fcntl(fdMemoria, F_ADD_SEALS, F_SEAL_SHRINK)<0){
+		close(fdMemoria);
+		return 0;
+	}
+	char* memoria= mmap(NULL, TAM_MEMORIA_COMPARTIDA, PROT_READ|PROT_WRITE, MAP_SHARED, fdMemoria, 0);
+	if(memoria==MAP_FAILED){
+		close(fdMemoria);
+		return 0;
+	}
+	Peticion peticion;
+	memset(&peticion, 0, sizeof(peticion));
+	peticion.id= siguienteId++;
+	peticion.operacion= OP_CONECTAR;
+	peticion.parametro= TAM_MEMORIA_COMPARTIDA;
+	char control[CMSG_SPACE(sizeof(int))];
+	memset(control, 0, sizeof(control));
+	struct iovec vector;
+	vector.iov_base= &peticion;
+	vector.iov_len= sizeof(peticion);
+	struct msghdr mensaje;
+	memset(&mensaje, 0, sizeof(mensaje));
+	mensaje.msg_iov= &vector;
+	mensaje.msg_iovlen= 1;
+	mensaje.msg_control= control;
+	mensaje.msg_controllen= sizeof(control);
+	struct cmsghdr* cabecera= CMSG_FIRSTHDR(&mensaje);
+	cabecera->cmsg_level= SOL_SOCKET;
+	cabecera->cmsg_type= SCM_RIGHTS;
+	cabecera->cmsg_len= CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cabecera), &fdMemoria, sizeof(int));
+	Respuesta respuesta;
+	int ret= sendmsg(socketServidor, &mensaje, MSG_NOSIGNAL)==sizeof(peticion) ? waitResponse(&respuesta, NULL, 0) : -1;
+	close(fdMemoria);
+	if(ret<0){
+		munmap(memoria, TAM_MEMORIA_COMPARTIDA);
+		disconnectFS();
+		return -1;
+	}
+	if(respuesta.resultado<0){
+		munmap(memoria, TAM_MEMORIA_COMPARTIDA);
+		return 0;
+	}
+	memoriaCompartida= memoria;
+	return 0;
+}
+
+/*
+ * @brief	Disconnects from the file system server.
+ * @return	0 if success, -1 otherwise.
+ */
+int disconnectFS(void)
+{
+	if(socketServidor<0){
+		return -1;
+	}
+	close(socketServidor);
+	socketServidor= -1;
+	if(memoriaCompartida!=NULL){
+		munmap(memoriaCompartida, TAM_MEMORIA_COMPARTIDA);
+		memoriaCompartida= NULL;
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Generates the proper file system structure in a storage device. Not available from a client: the device belongs to the server.
+ * @return 	-1.
+ */
+int mkFS(long deviceSize)
+{
+	(void) deviceSize;
+	return -1;
+}
+
+/*
+ * @brief 	Generates the file system structure in a storage device with the given format options. Not available from a client.
+ * @return 	-1.
+ */
+int mkFSOptions(long deviceSize, const FSOptions *options)
+{
+	(void) deviceSize;
+	(void) options;
+	return -1;
+}
+
+/*
+ * @brief 	Connects to the server that has the file system mounted.
+ * @return 	0 if success, -1 otherwise.
+ */
+int mountFS(void)
+{
+	return connectFS(FS_SOCKET);
+}
+
+/*
+ * @brief 	Connects to the server that has the file system mounted. The mount options are those chosen by the server.
+ * @return 	0 if success, -1 otherwise.
+ */
+int mountFSOptions(const FSMountOptions *options)
+{
+	(void) options;
+	return connectFS(FS_SOCKET);
+}
+
+/*
+ * @brief 	Disconnects from the server. The file system stays mounted for the other clients.
+ * @return 	0 if success, -1 otherwise.
+ */
+int unmountFS(void)
+{
+	return disconnectFS();
+}
+
+/*
+ * @brief	Creates a new file, provided it it doesn't exist in the file system.
+ * @return	0 if success, -1 if the file already exists, -2 in case of error.
+ */
+int createFile(char *fileName)
+{
+	return callWithName(OP_CREAR, fileName, -2, NULL);
+}
+
+/*
+ * @brief	Deletes a file, provided it exists in the file system.
+ * @return	0 if success, -1 if the file does not exist, -2 in case of error..
+ */
+int removeFile(char *fileName)
+{
+	return callWithName(OP_BORRAR, fileName, -2, NULL);
+}
+
+/*
+ * @brief 	Envía una operación de lote con los nombres de los ficheros uno tras otro y recoge el resultado de cada uno.
+ * @return 	Resultado de la operación, -2 en caso de error.
+ */
+static int callBatch(int operacion, char** fileNames, int numFiles, int* results){
+	if(fileNames==NULL || results==NULL || numFiles<0 || numFiles>(int) (sizeof(bufferRespuesta)/sizeof(int32_t))){
+		return -2;
+	}
+	char* nombres= (char*) malloc(MAX_DATOS_PETICION);
+	if(nombres==NULL){
+		return -2;
+	}
+	nombres[0]= '\0';
+	uint32_t longitud= 0;
+	int i;
+	for(i=0; i<numFiles; i++){
+		const char* nombre= fileNames[i]!=NULL ? fileNames[i] : "";
+		size_t longitudNombre= strlen(nombre)+1;
+		if(longitud+longitudNombre>MAX_DATOS_PETICION){
+			free(nombres);
+			return -2;
+		}
+		memcpy(nombres+longitud, nombre, longitudNombre);
+		longitud+= longitudNombre;
+	}
+	Peticion peticion;
+	memset(&peticion, 0, sizeof(peticion));
+	peticion.operacion= operacion;
+	peticion.descriptor= numFiles;
+	peticion.longitudDatos= longitud;
+	uint32_t longitudRespuesta= 0;
+	int ret= callServer(&peticion, nombres, -2, &longitudRespuesta);
+	free(nombres);
+	int32_t* resultados= (int32_t*) bufferRespuesta;
+	for(i=0; i<numFiles; i++){
+		results[i]= (uint32_t) i<longitudRespuesta/sizeof(int32_t) ? resultados[i] : -2;
+	}
+	return ret;
+}
+
+/*
+ * @brief	Creates several files at once.
+ * @return	Number of files created, -2 in case of error (no file is created).
+ */
+int createFiles(char **fileNames, int numFiles, int *results)
+{
+	return callBatch(OP_CREAR_LOTE, fileNames, numFiles, results);
+}
+
+/*
+ * @brief	Deletes several files at once.
+ * @return	Number of files deleted, -2 in case of error (no file is deleted).
+ */
+int removeFiles(char **fileNames, int numFiles, int *results)
+{
+	return callBatch(OP_BORRAR_LOTE, fileNames, numFiles, results);
+}
+
+/*
+ * @brief	Replaces the whole contents of an existing, closed file with the <length> bytes of <buffer>.
+ * @return	0 if success, -1 if the file does not exist, -2 in case of error.
+ */
+int replaceFile(char *fileName, void *buffer, int length)
+{
+	if(fileName==NULL || buffer==NULL || length<0){
+		return -2;
+	}
+	Peticion peticion;
+	memset(&peticion, 0, sizeof(peticion));
+	peticion.operacion= OP_REEMPLAZAR;
+	size_t longitudNombre= strlen(fileName)+1;
+
+	/* El contenido grande va por la memoria compartida y el pequeño a continuación del nombre */
+	if(memoriaCompartida!=NULL && length>=UMBRAL_MEMORIA_COMPARTIDA && length<=TAM_MEMORIA_COMPARTIDA){
+		memcpy(memoriaCompartida, buffer, length);
+		peticion.compartida= 1;
+		peticion.parametro= length;
+		peticion.longitudDatos= longitudNombre;
+		return longitudNombre<=MAX_DATOS_PETICION ? callServer(&peticion, fileName, -2, NULL) : -2;
+	}
+	if(longitudNombre+length>MAX_DATOS_PETICION){
+		return -2;
+	}
+	char* datos= (char*) malloc(longitudNombre+length);
+	if(datos==NULL){
+		return -2;
+	}
+	memcpy(datos, fileName, longitudNombre);
+	memcpy(datos+longitudNombre, buffer, length);
+	peticion.longitudDatos= longitudNombre+length;
+	int ret= callServer(&peticion, datos, -2, NULL);
+	free(datos);
+	return ret;
+}
+
+/*
+ * @brief	Opens an existing file.
+ * @return	The file descriptor if possible, -1 if file does not exist, -2 in case of error..
+ */
+int openFile(char *fileName)
+{
+	return callWithName(OP_ABRIR, fileName, -2, NULL);
+}
+
+/*
+ * @brief	Closes a file.
+ * @return	0 if success, -1 otherwise.
+ */
+int closeFile(int fileDescriptor)
+{
+	return callWithDescriptor(OP_CERRAR, fileDescriptor, 0, 0, -1);
+}
+
+/*
+ * @brief	Makes the data and metadata of an open file durable on the device.
+ * @return	0 if success, -1 otherwise.
+ */
+int syncFile(int fileDescriptor)
+{
+	return callWithDescriptor(OP_SINCRONIZAR, fileDescriptor, 0, 0, -1);
+}
+
+/*
+ * @brief	Makes the data and metadata of every file durable on the device.
+ * @return	0 if success, -1 otherwise.
+ */
+int syncFS(void)
+{
+	return callWithDescriptor(OP_SINCRONIZAR_TODO, -1, 0, 0, -1);
+}
+
+/*
+ * @brief	Gets the block buffer allocation counters of the server since the file system was mounted.
+ * @return	0 if success, -1 otherwise.
+ */
+int getAllocStats(FSAllocStats *stats)
+{
+	if(stats==NULL){
+		return -1;
+	}
+	uint32_t longitud= 0;
+	int ret= callWithName(OP_ESTADISTICAS_RESERVA, NULL, -1, &longitud);
+	if(ret==0 && longitud==sizeof(FSAllocStats)){
+		memcpy(stats, bufferRespuesta, sizeof(FSAllocStats));
+	}
+	return ret;
+}
+
+/*
+ * @brief	Gets the counters of the background scrubber of the server since the file system was mounted.
+ * @return	0 if success, -1 if the scrubber is not running.
+ */
+int getScrubStats(FSScrubStats *stats)
+{
+	if(stats==NULL){
+		return -1;
+	}
+	uint32_t longitud= 0;
+	int ret= callWithName(OP_ESTADISTICAS_VERIFICACION, NULL, -1, &longitud);
+	if(ret==0 && longitud==sizeof(FSScrubStats)){
+		memcpy(stats, bufferRespuesta, sizeof(FSScrubStats));
+	}
+	return ret;
+}
+
+/*
+ * @brief	Reads a number of bytes from a file and stores them in a buffer.
+ * @return	Number of bytes properly read, -1 in case of error.
+ */
+int readFile(int fileDescriptor, void *buffer, int numBytes)
+{
+	if(buffer==NULL || numBytes<0){
+		return -1;
+	}
+
+	/* Las lecturas grandes las deja el servidor en la memoria compartida y el resto llegan por el socket */
+	Peticion peticion;
+	memset(&peticion, 0, sizeof(peticion));
+	peticion.operacion= OP_LEER;
+	peticion.descriptor= fileDescriptor;
+	if(memoriaCompartida!=NULL && numBytes>=UMBRAL_MEMORIA_COMPARTIDA){
+		peticion.parametro= numBytes<TAM_MEMORIA_COMPARTIDA ? numBytes : TAM_MEMORIA_COMPARTIDA;
+		peticion.compartida= 1;
+		int ret= callServer(&peticion, NULL, -1, NULL);
+		if(ret>0){
+			memcpy(buffer, memoriaCompartida, ret);
+		}
+		return ret;
+	}
+	peticion.parametro= numBytes<MAX_DATOS_PETICION ? numBytes : MAX_DATOS_PETICION;
+	uint32_t longitud= 0;
+	int ret= callServer(&peticion, NULL, -1, &longitud);
+	if(ret>0){
+		memcpy(buffer, bufferRespuesta, (uint32_t) ret<longitud ? (uint32_t) ret : longitud);
+	}
+	return ret;
+}
+
+/*
+ * @brief	Writes a number of bytes from a buffer and into a file.
+ * @return	Number of bytes properly written, -1 in case of error.
+ */
+int writeFile(int fileDescriptor, void *buffer, int numBytes)
+{
+	if(buffer==NULL || numBytes<0){
+		return -1;
+	}
+
+	/* Las escrituras grandes se pasan por la memoria compartida y el resto por el socket */
+	Peticion peticion;
+	memset(&peticion, 0, sizeof(peticion));
+	peticion.operacion= OP_ESCRIBIR;
+	peticion.descriptor= fileDescriptor;
+	if(memoriaCompartida!=NULL && numBytes>=UMBRAL_MEMORIA_COMPARTIDA){
+		peticion.parametro= numBytes<TAM_MEMORIA_COMPARTIDA ? numBytes : TAM_MEMORIA_COMPARTIDA;
+		peticion.compartida= 1;
+		memcpy(memoriaCompartida, buffer, peticion.parametro);
+		return callServer(&peticion, NULL, -1, NULL);
+	}
+	peticion.longitudDatos= numBytes<MAX_DATOS_PETICION ? numBytes : MAX_DATOS_PETICION;
+	return callServer(&peticion, buffer, -1, NULL);
+}
+
+/*
+ * @brief	Modifies the position of the seek pointer of a file.
+ * @return	0 if succes, -1 otherwise.
+ */
+int lseekFile(int fileDescriptor, int whence, long offset)
+{
+	return callWithDescriptor(OP_POSICIONAR, fileDescriptor, whence, offset, -1);
+}
+
+/*
+ * @brief 	Verifies the integrity of the file system metadata.
+ * @return 	0 if the file system is correct, -1 if the file system is corrupted, -2 in case of error.
+ */
+int checkFS(void)
+{
+	return callWithDescriptor(OP_COMPROBAR_FS, -1, 0, 0, -2);
+}
+
+/*
+ * @brief 	Verifies the integrity of a file.
+ * @return 	0 if the file is correct, -1 if the file is corrupted, -2 in case of error.
+ */
+int checkFile(char *fileName)
+{
+	return callWithName(OP_COMPROBAR, fileName, -2, NULL);
+}
+
+/*
+ * @brief	Obtains the attributes of a file. The name is valid until the next call to statFile.
+ * @return	0 if success, -1 if the file does not exist, -2 in case of error.
+ */
+int statFile(char *fileName, FileStat *info)
+{
+	if(fileName==NULL || info==NULL){
+		return -2;
+	}
+	uint32_t longitud= 0;
+	int ret= callWithName(OP_ESTADO, fileName, -2, &longitud);
+	if(ret!=0){
+		return ret;
+	}
+	if(longitud<=sizeof(AtributosFichero)){
+		return -2;
+	}
+	AtributosFichero atributos;
+	memcpy(&atributos, bufferRespuesta, sizeof(atributos));
+	memcpy(nombreEstado, bufferRespuesta+sizeof(atributos), longitud-sizeof(atributos));
+	nombreEstado[longitud-sizeof(atributos)-1]= '\0';
+	info->name= nombreEstado;
+	info->size= atributos.tamanyo;
+	info->written= atributos.escrito;
+	return 0;
+}
+
+/*
+ * @brief	Calls <callback> with the attributes of every file whose name starts with <prefix>, in name order. The list is
+ * 		obtained from the server with a single request.
+ * @return	Number of files passed to the callback, -1 in case of error.
+ */
+int listFiles(char *prefix, int (*callback)(const FileStat *info, void *arg), void *arg)
+{
+	if(callback==NULL){
+		return -1;
+	}
+	uint32_t longitud= 0;
+	int ret= callWithName(OP_LISTAR, prefix, -1, &longitud);
+	if(ret<0){
+		return ret;
+	}
+
+	/* Recorrido de los atributos y nombres recibidos, sobre una copia para que el callback pueda llamar a otras funciones */
+	char* lista= (char*) malloc(longitud>0 ? longitud : 1);
+	if(lista==NULL){
+		return -1;
+	}
+	memcpy(lista, bufferRespuesta, longitud);
+	int listados= 0;
+	uint32_t posicion= 0;
+	while(posicion+sizeof(AtributosFichero)<longitud){
+		AtributosFichero atributos;
+		memcpy(&atributos, lista+posicion, sizeof(atributos));
+		char* nombre= lista+posicion+sizeof(atributos);
+		char* fin= memchr(nombre, '\0', longitud-posicion-sizeof(atributos));
+		if(fin==NULL){
+			break;
+		}
+		FileStat info;
+		info.name= nombre;
+		info.size= atributos.tamanyo;
+		info.written= atributos.escrito;
+		listados++;
+		if(callback(&info, arg)){
+			break;
+		}
+		posicion= fin-lista+1;
+	}
+	free(lista);
+	return listados;
+}
+
+/*
+ * @brief	Maps the contents of an open file. Not available from a client: the file system is mapped in the server.
+ * @return	NULL.
+ */
+const void *mapFile(int fileDescriptor, int *length)
+{
+	(void) fileDescriptor;
+	(void) length;
+	return NULL;
+}
+
+/*
+ * @brief	Releases a mapping obtained with mapFile. Not available from a client.
+ * @return	-1.
+ */
+int unmapFile(int fileDescriptor)
+{
+	(void) fileDescriptor;
+	return -1;
+}
@@ -6,6 +6,7 @@
  * @date	01/03/2017
  */
 
+#define _GNU_SOURCE			// Necesario para O_DIRECT y fallocate
 #include "include/filesystem.h"		// Headers for the core functionality
 #include "include/auxiliary.h"		// Headers for auxiliary functions
 #include "include/metadata.h"		// Type and structure declaration of the file system
@@ -13,6 +14,93 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+/* Imágenes sobre las que se reparten los bloques (striping) */
+static char* dispositivos[MAX_DISPOSITIVOS]= {DEVICE_IMAGE};	// Nombres de las imágenes. La imagen 0 contiene los metadatos.
+static int numDispositivos= 1;				// Número de imágenes
+static int nombresPropios;				// 1 si los nombres de dispositivos se han copiado con strdup y hay que liberarlos
+
+/* Acceso al dispositivo y buffers de bloque alineados */
+static int accesoDirecto;				// 1 si las imágenes están abiertas con O_DIRECT, 0 si se accede mediante bread/bwrite
+static int fdDirectos[MAX_DISPOSITIVOS];		// Descriptor de cada imagen abierta con O_DIRECT
+static char* memoriaPool;				// Memoria alineada de la que se obtienen los buffers del pool
+static int separacionPool;				// Separación en bytes entre dos buffers consecutivos del pool (tamBloque redondeado al alineamiento)
+static char* buffersLibres[TAM_POOL_BUFFERS];		// Pila de buffers del pool libres
+static int numBuffersLibres;				// Número de buffers del pool libres
+static long peticionesBuffer;				// Buffers de bloque pedidos desde el montaje
+static long reservasHeap;				// Peticiones que no se han podido servir desde el pool y han reservado memoria
+static pthread_mutex_t mutexPool= PTHREAD_MUTEX_INITIALIZER;
+
+/* Estado de la durabilidad: política del montaje y sincronización agrupada (group commit) */
+static int politicaDurabilidad;				// Política de durabilidad del montaje (FS_DURABILITY_*)
+static int intervaloSincronizacion;			// Intervalo de la sincronización periódica, en milisegundos
+static int fdSincronizacion[MAX_DISPOSITIVOS];		// Descriptor de cada imagen sobre el que se hace fsync
+static int sincronizacionAbierta;			// 1 si fdSincronizacion está abierto
+static unsigned long syncPedidos;			// Número de peticiones de fsync recibidas. Cada petición obtiene como turno el valor tras incrementarlo.
+static unsigned long syncCompletados;			// Todas las peticiones con turno menor o igual a este valor están en disco
+static int syncEnCurso;					// 1 mientras un hilo está ejecutando un fsync en nombre de su lote
+static int cambiosPendientes;				// 1 si hay metadatos escritos que la sincronización periódica aún no ha llevado a disco
+static int sincronizacionActiva;			// 1 mientras el hilo de sincronización periódica está en ejecución
+static pthread_t hiloSincronizacion;
+static pthread_mutex_t mutexSync= PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t condSync= PTHREAD_COND_INITIALIZER;		// Señala el final de un fsync a las peticiones que esperan su lote
+static pthread_cond_t condTemporizador= PTHREAD_COND_INITIALIZER;	// Despierta al hilo de sincronización periódica para que termine
+
+/* Verificación de integridad en segundo plano (scrubber) */
+static pthread_mutex_t mutexInodos= PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;	// Excluye la verificación en segundo plano de las operaciones que modifican Inodos o metadatos en disco
+static int verificacionActiva;				// 1 mientras el hilo de verificación está en ejecución. Se lee y se escribe con mutexVerificacion.
+static int bloquesPorSegundo;				// Ritmo máximo de lectura de bloques del hilo de verificación
+static int aislarCorruptos;				// 1 si los ficheros corruptos se ponen en cuarentena
+static void (*informarCorrupcion)(const char *fileName, void *arg);	// Función a la que se informa de cada fichero corrupto (NULL si no hay)
+static void* argumentoInforme;				// Argumento de informarCorrupcion
+static FSScrubStats estadisticasVerificacion;		// Contadores de la verificación en segundo plano
+static pthread_t hiloVerificacion;
+static pthread_mutex_t mutexVerificacion= PTHREAD_MUTEX_INITIALIZER;	// Protege la espera entre lecturas y las estadísticas de la verificación
+static pthread_cond_t condVerificacion= PTHREAD_COND_INITIALIZER;	// Despierta al hilo de verificación para que termine
+
+/* Escritura en modo registro (log-structured) y limpiador del registro */
+static char bloquesRetirados[MAX_BLOQUES_DATOS];	// Bloques cuyo contenido se ha vuelto a escribir en la cabeza del registro. Siguen ocupados hasta que se escriben los metadatos que ya no los referencian.
+static char bloquesPorLiberar[MAX_BLOQUES_DATOS];	// Bloques liberados cuyo espacio en la imagen se devuelve (hole punching) después de la siguiente escritura de los metadatos.
+static char bloquesPorPerforar[MAX_BLOQUES_DATOS];	// Bloques liberados por metadatos ya escritos. Su espacio se devuelve a la imagen cuando esos metadatos son duraderos.
+static char libresEscritos[MAX_BLOQUES_DATOS];		// Bloques libres en los últimos metadatos escritos
+static unsigned long escriturasMetadatos;		// Número de escrituras de los metadatos. Sólo se perforan huecos si no ha habido otra escritura desde la que se confirma.
+static int limpiadorActivo;				// 1 mientras el hilo limpiador del registro está en ejecución. Se lee y se escribe con mutexLimpiador.
+static pthread_t hiloLimpiador;
+static pthread_mutex_t mutexLimpiador= PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t condLimpiador= PTHREAD_COND_INITIALIZER;	// Despierta al hilo limpiador cuando quedan pocos segmentos libres o para que termine
+
+/* Estado de la precarga de bloques de datos (readahead) */
+static EntradaCache cacheLectura[CACHE_BLOQUES];	// Caché de bloques de datos leídos o precargados
+static int manecillaCache;				// Siguiente entrada candidata a ser reemplazada en la caché
+static int colaPrecarga[COLA_READAHEAD];		// Cola circular de bloques pendientes de precargar
+static int inicioCola, numPendientes;			// Primera posición ocupada de la cola y número de peticiones pendientes
+static int ultimoBloqueLeido= -1;			// Último bloque de datos leído. Sirve para detectar recorridos secuenciales entre ficheros. Se lee y se escribe con mutexInodos.
+static int ventanaReadahead;				// Número de ficheros que se precargan por delante. Crece con los accesos secuenciales y se anula con los aleatorios. Se lee y se escribe con mutexInodos.
+static int readaheadActivo;				// 1 mientras el hilo de precarga está en ejecución
+static pthread_t hiloPrecarga;
+static pthread_mutex_t mutexCache= PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t condPrecarga= PTHREAD_COND_INITIALIZER;	// Señala al hilo de precarga que hay peticiones pendientes
+static pthread_cond_t condCargado= PTHREAD_COND_INITIALIZER;	// Señala a los lectores que ha terminado una carga en segundo plano
+
+/* Índice en memoria de los ficheros ordenados por nombre */
+static int* indiceNombres;				// Identificadores de los ficheros existentes ordenados por nombre
+static int numIndiceNombres;				// Número de ficheros en el índice
+
+/* Proyección en memoria de las imágenes utilizada por mapFile */
+static char* imagenesMapeadas[MAX_DISPOSITIVOS];	// Dirección del bloque 0 de cada imagen proyectada. NULL si no está proyectada.
+static size_t tamImagenesMapeadas[MAX_DISPOSITIVOS];	// Número de bytes proyectados de cada imagen
+static const char bloqueCeros[MAX_TAM_BLOQUE];		// Contenido de los ficheros cuyo bloque de datos no se ha escrito nunca
+
+/* Buffer en el que se reúnen los metadatos para calcular su CRC. Su tamaño es el de los metadatos con el máximo de Inodos y de nombres. */
+static unsigned char bufferMetadatos[sizeof(SuperBloque)+MAX_FILE+MAX_BLOQUES_DATOS+sizeof(Inodo)*MAX_FILE+MAX_MONTON_NOMBRES];
 
 /*
  * @brief 	Generates the proper file system structure in a storage device, as designed by the student.
@@ -20,17 +108,50 @@
  */
 int mkFS(long deviceSize)
 {
-	long maxCapacidad= BLOCK_SIZE*(2+MAX_FILE);		// Capacidad máxima que puede gestionar el sistema de ficheros (2 bloques para metadatos y 64 bloques para datos).
-	int minCapacidad= BLOCK_SIZE*2;				// Capacidad mínima que ha de tener el dispositivo para soportar el sistema de ficheros (1 bloque para metadatos y 1 bloque de datos)
+	return mkFSOptions(deviceSize, NULL);
+}
+
+/*
+ * @brief 	Generates the file system structure in a storage device with the given format options.
+ * @return 	0 if success, -1 otherwise.
+ */
+int mkFSOptions(long deviceSize, const FSOptions *options)
+{
+	/* Obtención y validación del tamaño de bloque. Ha de ser una potencia de 2 entre BLOCK_SIZE y MAX_TAM_BLOQUE para que
+	   cada bloque del sistema de ficheros esté formado por un número entero de bloques del dispositivo. */
+	int tamBloqueFS= (options!=NULL && options->blockSize>0) ? options->blockSize : BLOCK_SIZE;
+	if(tamBloqueFS<BLOCK_SIZE || tamBloqueFS>MAX_TAM_BLOQUE || (tamBloqueFS & (tamBloqueFS-1))){
+		return -1;
+	}
+	tamBloque= tamBloqueFS;
+	tamSector= tamBloque/NUM_SECTORES_CRC;
+
+	/* Obtención de las imágenes entre las que se reparten los bloques de datos */
+	if(setDevices(options!=NULL ? options->devices : NULL, options!=NULL ? options->numDevices : 0)<0){
+		return -1;
+	}
+
+	long maxCapacidad= (long) tamBloque*(2+MAX_BLOQUES_DATOS);	// Capacidad máxima que puede gestionar el sistema de ficheros (2 bloques para metadatos y 128 bloques para datos).
+	long minCapacidad= (long) tamBloque*2;			// Capacidad mínima que ha de tener el dispositivo para soportar el sistema de ficheros (1 bloque para metadatos y 1 bloque de datos)
 	int numBloquesDatos;					// Número de bloques de datos.
-	FILE *fp;						// Puntero a la primera posición de memoria del disco.
-	int tamanyoDisco;					// Tamaño del disco sobre el que se desea formatear una partición.
+	int numInodos;						// Número de Inodos (número máximo de ficheros).
+	struct stat infoDisco;					// Información del fichero que simula el disco.
+	long tamanyoDisco;					// Tamaño del disco sobre el que se desea formatear una partición.
 	int tamPrimerBloqueOcupado;				// Número de bytes del primer bloque ocupados (sin considerar los inodos).
 
-	/* Se comprueba que la partición a formatear no exceda el tamaño del disco */
-	fp=fopen(DEVICE_IMAGE,"r");
-	fseek(fp, 0L, SEEK_END);
-	tamanyoDisco= ftell(fp);
+	long tamImagenes[MAX_DISPOSITIVOS];			// Tamaño de cada imagen.
+
+	/* Se comprueba que la partición a formatear no exceda el tamaño del disco (la suma de las imágenes). El tamaño se obtiene
+	   de los atributos de los ficheros, sin necesidad de abrirlos ni recorrerlos. */
+	int i;
+	tamanyoDisco= 0;
+	for(i=0; i<numDispositivos; i++){
+		if(stat(dispositivos[i], &infoDisco)<0){
+			return -1;
+		}
+		tamImagenes[i]= (long) infoDisco.st_size;
+		tamanyoDisco+= tamImagenes[i];
+	}
 
 	if(deviceSize>tamanyoDisco){
 		return -1;
@@ -47,36 +168,93 @@ int mkFS(long deviceSize)
 		deviceSize=maxCapacidad;
 	}
 
-	/* Se calcula si es necesario añadir un bloque extra para los Inodos ya que puede ocurrir que no quepan en el primer bloque del disco*/
-	numBloquesDatos= (deviceSize/2048)-1;
-	tamPrimerBloqueOcupado= sizeof(s_bloque)+sizeof(mapaInodos)+sizeof(CRCmetadata); 
-	iNodosPrimerBloque= (int) ((BLOCK_SIZE - tamPrimerBloqueOcupado)/sizeof(Inodo));	// Número de Inodos que caben en el primer bloque.
-	iNodosExtra= numBloquesDatos-iNodosPrimerBloque;					// Número de Inodos que no caben en el primer bloque.
-	if(iNodosExtra>0){									// Si no caben los Inodos en un sólo bloque, se reduce el número de bloques
-		numBloquesDatos--;								// de datos en 1 (porque se necesita un bloque extra del disco para los Inodos)
-		iNodosExtra= numBloquesDatos-iNodosPrimerBloque;				// y se actualiza el número de Inodos que ocuparán el segundo bloque de disco.
+	/* Obtención y validación del número de Inodos. Por defecto hay un Inodo por cada bloque de datos (hasta MAX_FILE). */
+	if(options!=NULL && (options->numInodes<0 || options->numInodes>MAX_FILE)){
+		return -1;
+	}
+	numBloquesDatos= (deviceSize/tamBloque)-1;
+	numInodos= (options!=NULL && options->numInodes>0) ? options->numInodes : (numBloquesDatos<MAX_FILE ? numBloquesDatos : MAX_FILE);
+
+	/* Se calcula si es necesario añadir un segundo bloque de metadatos. Todos los Inodos caben en el primer bloque y el resto del
+	   bloque es el montón de nombres; si en él no quedan LONGITUD_MEDIA_NOMBRE bytes por Inodo el montón continúa en un segundo bloque. */
+	tamPrimerBloqueOcupado= sizeof(s_bloque)+sizeof(mapaInodos)+sizeof(mapaBloques)+sizeof(CRCmetadata); 
+	bloquesMetadatos= 1;
+	if(tamBloque-tamPrimerBloqueOcupado-(int) sizeof(Inodo)*numInodos < LONGITUD_MEDIA_NOMBRE*numInodos){
+		bloquesMetadatos= 2;								// Si el montón no cabe en un sólo bloque, se reduce el número de bloques
+		numBloquesDatos--;								// de datos en 1 (porque se necesita un bloque extra del disco para los nombres).
+		if(options==NULL || options->numInodes<=0){					// El número de Inodos por defecto se ajusta a los bloques de datos que quedan.
+			numInodos= numBloquesDatos<MAX_FILE ? numBloquesDatos : MAX_FILE;
+		}
 	}
-	else{											// Si caben todos los Inodos en un bloque, se actualiza el número de Inodos extra
-		iNodosExtra=0;									// a 0 y el número de Inodos en el primer bloque se actualiza al número de bloques de datos.
-		iNodosPrimerBloque= numBloquesDatos;
+	if(numBloquesDatos>MAX_BLOQUES_DATOS){
+		numBloquesDatos= MAX_BLOQUES_DATOS;
+	}
+	if(numBloquesDatos<1 || numInodos<1){
+		return -1;
+	}
+
+	/* Se comprueba que cada imagen puede contener su parte de los bloques de datos. Todas las imágenes reservan al principio
+	   los bloques de metadatos para que un bloque de datos ocupe la misma posición en todas ellas. */
+	int bloquesPorImagen= bloquesMetadatos + (numBloquesDatos+numDispositivos-1)/numDispositivos;
+	for(i=0; i<numDispositivos; i++){
+		if(tamImagenes[i]<(long) bloquesPorImagen*tamBloque){
+			return -1;
+		}
 	}
 
-	/* Inicialización del superbloque */
-	s_bloque.numInodos= numBloquesDatos;
+	/* Inicialización del superbloque. Sólo se escribe el bloque 0: el resto de bloques de Inodos quedan por encima de la
+	   marca de agua y se inicializan bajo demanda la primera vez que se escriben los metadatos. */
+	s_bloque.numInodos= numInodos;
+	s_bloque.bloquesIniciados= 1;
+	s_bloque.sectoresBloque= tamBloque/BLOCK_SIZE;
+	s_bloque.numDispositivos= numDispositivos;
+	s_bloque.indiceDispositivo= 0;
+	s_bloque.desmontadoLimpio= 1;
+	s_bloque.bloquesMetadatos= bloquesMetadatos;
+	s_bloque.numBloquesDatos= numBloquesDatos;
+	s_bloque.modoRegistro= options!=NULL && options->logStructured ? 1 : 0;
+	s_bloque.cabezaRegistro= 0;
+	s_bloque.finMontonNombres= 0;
+	s_bloque.identificador= (uint32_t) time(NULL) ^ ((uint32_t) getpid()<<16);
 	
-	/* Inicialización del mapa de Inodos */
+	/* Inicialización de los mapas de Inodos y de bloques: todos libres */
 	memset(mapaInodos,0, MAX_FILE);
+	memset(mapaBloques,0, sizeof(mapaBloques));
 
-	/* Inicialización de los Inodos */					
+	/* Inicialización de los Inodos y del montón de nombres vacío */					
 	ArrayInodos= (Inodo *) calloc(s_bloque.numInodos, sizeof(Inodo));
+	if(ArrayInodos==NULL || initNameHeap()<0){
+		free(ArrayInodos);
+		ArrayInodos= NULL;
+		return -1;
+	}
 
 	/* Escritura de los metadatos por defecto al disco*/
-	if(writeMetadata()<0){
+	int ret= writeMetadata();
+	free(ArrayInodos);
+	free(montonNombres);
+	ArrayInodos= NULL;
+	montonNombres= NULL;
+	if(ret<0){
 		return -1;
 	}
 
-	/* Liberación de la memoria reservada */
-	free(ArrayInodos);
+	/* Escritura en el bloque 0 del resto de imágenes de una copia del superbloque con su posición en el conjunto */
+	if(numDispositivos>1){
+		char w_bloque[BLOCK_SIZE]= {0};
+		for(i=1; i<numDispositivos; i++){
+			SuperBloque copia= s_bloque;
+			copia.indiceDispositivo= i;
+			memcpy(w_bloque, &copia, sizeof(copia));
+			if(bwrite(dispositivos[i], 0, w_bloque)<0){
+				return -1;
+			}
+		}
+	}
+
+	/* Los bloques de datos de la partición se dejan como huecos en las imágenes (ficheros dispersos): no ocupan espacio hasta
+	   que se escriben. Si el sistema de ficheros de las imágenes no lo admite conservan su contenido, que nunca se lee. */
+	punchImages(bloquesMetadatos, bloquesPorImagen);
 
 	return 0;
 }
@@ -85,59 +263,196 @@ int mkFS(long deviceSize)
  * @brief 	Mounts a file system in the simulated device.
  * @return 	0 if success, -1 otherwise.
  */
-
-
 int mountFS(void)
 {
-	/* Lectura del primer bloque de disco para obtener los metadatos */
-	char* r_bloque= (char *) malloc(BLOCK_SIZE);
-	if(bread(DEVICE_IMAGE, 0, r_bloque)<0){
+	return mountFSOptions(NULL);
+}
+
+/*
+ * @brief 	Mounts a file system in the simulated device with the given mount options.
+ * @return 	0 if success, -1 otherwise.
+ */
+int mountFSOptions(const FSMountOptions *options)
+{
+	/* Obtención de las imágenes del sistema de ficheros */
+	if(setDevices(options!=NULL ? options->devices : NULL, options!=NULL ? options->numDevices : 0)<0){
+		return -1;
+	}
+
+	/* Lectura del superbloque, que está al principio del primer bloque del dispositivo, para obtener el tamaño de bloque */
+	char r_superbloque[BLOCK_SIZE];
+	if(bread(dispositivos[0], 0, r_superbloque)<0){
+		return -1;
+	}
+	memcpy(&s_bloque, r_superbloque, sizeof(s_bloque));
+	if(s_bloque.sectoresBloque==0 || s_bloque.sectoresBloque>MAX_TAM_BLOQUE/BLOCK_SIZE){
+		return -1;
+	}
+
+	/* Comprobación de que se han dado las imágenes del conjunto y en su orden: cada una guarda su posición en una copia del superbloque */
+	if(s_bloque.numDispositivos!=numDispositivos || s_bloque.indiceDispositivo!=0){
+		return -1;
+	}
+	int i;
+	for(i=1; i<numDispositivos; i++){
+		SuperBloque copia;
+		char r_copia[BLOCK_SIZE];
+		if(bread(dispositivos[i], 0, r_copia)<0){
+			return -1;
+		}
+		memcpy(&copia, r_copia, sizeof(copia));
+		if(copia.identificador!=s_bloque.identificador || copia.indiceDispositivo!=i || copia.numDispositivos!=numDispositivos){
+			return -1;
+		}
+	}
+	tamBloque= s_bloque.sectoresBloque*BLOCK_SIZE;
+	tamSector= tamBloque/NUM_SECTORES_CRC;
+
+	/* Reserva de los buffers de bloque alineados y apertura del dispositivo en modo directo (si se ha pedido) */
+	if(initBufferPool()<0){
+		return -1;
+	}
+	if(options!=NULL && options->directIO && openDirectDevice()<0){
+		destroyBufferPool();
+		return -1;
+	}
+
+	/* Lectura del primer bloque del sistema de ficheros completo para obtener los metadatos. Si coincide con el bloque del
+	   dispositivo ya leído no se vuelve a leer. */
+	char* r_bloque= getBlockBuffer();
+	if(tamBloque==BLOCK_SIZE && !accesoDirecto){
+		memcpy(r_bloque, r_superbloque, BLOCK_SIZE);
+	}
+	else if(readBlock(0, r_bloque)<0){
+		releaseBlockBuffer(r_bloque);
+		releaseMountState();
 		return -1;
 	}
 	
-	/* Traspaso del superbloque, mapa de Inodos y CRC a las variables del programa */
+	/* Traspaso del superbloque, mapas de Inodos y de bloques y CRC a las variables del programa */
 	memcpy(&s_bloque, r_bloque, sizeof(s_bloque));
+	if(s_bloque.numInodos==0 || s_bloque.numInodos>MAX_FILE || s_bloque.numBloquesDatos==0 || s_bloque.numBloquesDatos>MAX_BLOQUES_DATOS){
+		releaseBlockBuffer(r_bloque);
+		releaseMountState();
+		return -1;
+	}
 	memcpy(mapaInodos, r_bloque + sizeof(s_bloque), sizeof(mapaInodos));
-	memcpy(&CRCmetadata, r_bloque + sizeof(s_bloque) + sizeof(mapaInodos), sizeof(CRCmetadata));
-	ArrayInodos= (Inodo *) calloc(s_bloque.numInodos, sizeof(Inodo));
+	memcpy(mapaBloques, r_bloque + sizeof(s_bloque) + sizeof(mapaInodos), sizeof(mapaBloques));
+	memcpy(&CRCmetadata, r_bloque + sizeof(s_bloque) + sizeof(mapaInodos) + sizeof(mapaBloques), sizeof(CRCmetadata));
 
-	/* Cálculo del número de Inodos que ocupan el primer bloque de disco y el segundo bloque. 
-	   Aunque este cálculo ya se realiza en mkfs se tiene que repetir aquí ya que esta es la primera función
-	   del sistema de ficheros que ejecuta un programa cliente y la única forma
-	   de disponer de estas variables en memoria es volver a calcularlas a partir de la información en disco.*/
-	int tamanyoLibre= BLOCK_SIZE - sizeof(s_bloque) - sizeof(mapaInodos) - sizeof(CRCmetadata);	// Tamaño disponible en el primer bloque sin contar los Inodos.
-	iNodosPrimerBloque= (int) (tamanyoLibre/sizeof(Inodo));						// Número de Inodos que caben en el primer bloque
-	if(s_bloque.numInodos>iNodosPrimerBloque){							// Si el número de Inodos del sistema supera el número de Inodos que caben
-		iNodosExtra=s_bloque.numInodos-iNodosPrimerBloque;					// en el primer bloque, entonces se necesita un segundo bloque para Inodos, de lo contrario no.
-	}
-	else{
-		iNodosExtra=0;
-		iNodosPrimerBloque=s_bloque.numInodos;
+	/* Número de bloques de metadatos, guardado en el superbloque por mkFS. Con él se calcula la capacidad del montón de nombres. */
+	int desmontadoLimpio= s_bloque.desmontadoLimpio;
+	bloquesMetadatos= s_bloque.bloquesMetadatos;
+	ArrayInodos= (Inodo *) calloc(s_bloque.numInodos, sizeof(Inodo));
+	if(bloquesMetadatos<1 || bloquesMetadatos>2 || ArrayInodos==NULL || initNameHeap()<0 || s_bloque.finMontonNombres>tamMontonNombres){
+		releaseBlockBuffer(r_bloque);
+		releaseMountState();
+		return -1;
 	}
 
-	/* Traspaso de los Inodos del primer bloque de disco al vector de Inodos del programa */
-	memcpy(ArrayInodos, r_bloque+sizeof(s_bloque)+sizeof(mapaInodos)+sizeof(CRCmetadata), sizeof(Inodo)*iNodosPrimerBloque);
+	/* Traspaso de los Inodos y del montón de nombres (del primer bloque de disco y, si lo hay, del segundo) a las variables del programa */
+	if(readMetadataBlocks(r_bloque, ArrayInodos, montonNombres)<0){
+		releaseBlockBuffer(r_bloque);
+		releaseMountState();
+		return -1;
+	}
 
-	/* Lectura del segundo bloque de disco y traspaso de los Inodos de dicho bloque al vector de Inodos del programa */
-	if(iNodosExtra>0){
-		if(bread(DEVICE_IMAGE, 1, r_bloque)<0){
+	/* Los nombres de los ficheros existentes han de estar dentro de la parte ocupada del montón */
+	for(i=0; i<s_bloque.numInodos; i++){
+		if(mapaInodos[i] && ArrayInodos[i].nombre>=s_bloque.finMontonNombres){
+			releaseBlockBuffer(r_bloque);
+			releaseMountState();
 			return -1;
 		}
-		memcpy(ArrayInodos+sizeof(Inodo)*iNodosPrimerBloque, r_bloque, sizeof(Inodo)*iNodosExtra );
 	}
 	
-	/* Liberación de la memoria reservada para la lectura del disco */
-	free(r_bloque);
+	/* Liberación del buffer utilizado para la lectura del disco */
+	releaseBlockBuffer(r_bloque);
+
+	/* Inicialización del pool de descriptores. Su tamaño se elige al montar, independientemente del número de Inodos, para que la
+	   memoria de los descriptores no crezca con el número de ficheros. Todos los descriptores se encadenan en orden en la lista de libres. */
+	numDescriptores= (options!=NULL && options->maxOpenFiles>0) ? options->maxOpenFiles : NUM_DESCRIPTORES;
+	ArrayDescriptores= (Descriptor *) calloc(numDescriptores, sizeof(Descriptor));
+	if(ArrayDescriptores==NULL){
+		releaseMountState();
+		return -1;
+	}
+	for(i=0; i<numDescriptores; i++){
+		ArrayDescriptores[i].idFichero=-1;	// No se puede poner a "0" ya que el identificador del fichero puede ser "0" y no habría forma de diferenciar
+							// entre el identificador o si está inicializado.
+		ArrayDescriptores[i].siguiente= i+1<numDescriptores ? i+1 : -1;
+	}
+	primerDescLibre= 0;
 
-	/* Inicialización del array de descriptores */
-	ArrayDescriptores= (Descriptor *) calloc(s_bloque.numInodos, sizeof(Descriptor));
-	int i;
+	/* Inicialización del estado en memoria de los Inodos: ningún fichero está abierto */
+	ArrayEstados= (EstadoInodo *) calloc(s_bloque.numInodos, sizeof(EstadoInodo));
+	if(ArrayEstados==NULL){
+		releaseMountState();
+		return -1;
+	}
 	for(i=0; i<s_bloque.numInodos; i++){
-		ArrayDescriptores[i].idFichero=-1;	// No se puede poner a "0" ya que el identificador del fichero puede ser "0" y no habría forma de diferenciar
-	}						// entre el identificador o si está inicializado.
+		ArrayEstados[i].primerDesc=-1;
+	}
 	
-	/* Comprobación de la integridad de los metadatos */
-	if(checkFS()<0){
+	/* Comprobación de la integridad de los metadatos, sólo si el sistema de ficheros no se desmontó correctamente (por ejemplo, tras
+	   una caída). Se comprueba el CRC de los metadatos ya leídos, sin volver a leerlos del disco. Se hace también si hay verificación
+	   en segundo plano: el mapa de bloques se reconstruye a continuación a partir de los Inodos, y un Inodo corrupto podría dejar
+	   libre el bloque de otro fichero antes de que el hilo de verificación llegue a comprobarlo. */
+	if(!desmontadoLimpio){
+		uint16_t crcDisco= CRCmetadata;
+		updateCRCMetadata();
+		if(CRCmetadata!=crcDisco){
+			releaseMountState();
+			return -1;
+		}
+	}
+
+	/* Tras un desmontaje incorrecto el mapa de bloques puede tener reservados bloques que no se llegaron a asignar a ningún
+	   fichero (escrituras en curso durante la caída). Se reconstruye a partir de los Inodos para recuperarlos. */
+	if(!desmontadoLimpio){
+		memset(mapaBloques, 0, sizeof(mapaBloques));
+		for(i=0; i<s_bloque.numInodos; i++){
+			if(mapaInodos[i] && !ArrayInodos[i].sinEscribir && ArrayInodos[i].bloqueDatos<s_bloque.numBloquesDatos){
+				mapaBloques[ArrayInodos[i].bloqueDatos]= 1;
+			}
+		}
+	}
+
+	/* Construcción del índice de nombres */
+	if(buildNameIndex()<0){
+		releaseMountState();
+		return -1;
+	}
+
+	/* Arranque de la caché de lectura y del hilo de precarga */
+	if(initReadahead()<0){
+		releaseMountState();
+		return -1;
+	}
+
+	/* Preparación de la política de durabilidad */
+	if(initDurability(options!=NULL ? options->durability : FS_DURABILITY_NONE, options!=NULL ? options->groupCommitMs : 0)<0){
+		releaseMountState();
+		return -1;
+	}
+
+	/* Se marca en disco que el sistema de ficheros está montado, para que si no se desmonta correctamente el siguiente montaje
+	   compruebe los metadatos. Sólo se escribe el primer bloque de metadatos. */
+	s_bloque.desmontadoLimpio= 0;
+	if(writeSuperblock()<0 || metadataCommitted()<0){
+		releaseMountState();
+		return -1;
+	}
+
+	/* Arranque de la verificación en segundo plano (si se ha pedido) */
+	if(options!=NULL && options->scrubRate>0 && initScrubber(options)<0){
+		releaseMountState();
+		return -1;
+	}
+
+	/* Arranque del limpiador si el sistema de ficheros se formateó en modo registro */
+	if(s_bloque.modoRegistro && initCleaner()<0){
+		releaseMountState();
 		return -1;
 	}
 	
@@ -152,77 +467,98 @@ int unmountFS(void)
 {
 	/* Comprueba que no existen ficheros abiertos */
 	int i;
-	for(i=0; i<s_bloque.numInodos; i++){
+	for(i=0; i<numDescriptores; i++){
 		if(ArrayDescriptores[i].estado){
 			return -1;
 		}
 	}
 
-	/* Escribe los metadatos a disco */
+	/* Escribe los metadatos a disco. Salvo con la política FS_DURABILITY_NONE, el desmontaje deja el sistema de ficheros en disco
+	   antes de marcarlo como desmontado correctamente, para que la marca no pueda llegar a disco antes que lo que describe. */
 	if(writeMetadata()<0){
 		return -1;
 	}
+	if(politicaDurabilidad!=FS_DURABILITY_NONE && syncDevice()<0){
+		return -1;
+	}
+
+	/* Escribe la marca de desmontaje correcto en el superbloque. Si no se puede hacer duradera se retira, en memoria y en disco,
+	   para que el siguiente montaje compruebe los metadatos. */
+	s_bloque.desmontadoLimpio= 1;
+	if(writeSuperblock()<0 || (politicaDurabilidad!=FS_DURABILITY_NONE && syncDevice()<0)){
+		s_bloque.desmontadoLimpio= 0;
+		writeSuperblock();
+		return -1;
+	}
 
 	/* Liberación de las variables utilizadas por el sistema de ficheros */
-	free(ArrayInodos);
-	free(ArrayDescriptores);
-	iNodosPrimerBloque=0;
-	iNodosExtra=0;
-	CRCmetadata=0;
-	memset(mapaInodos, 0, sizeof(mapaInodos));
-	memset(&s_bloque, 0, sizeof(s_bloque));
+	releaseMountState();
 
 	return 0;
 }
 
+
 /*
- * @brief	Creates a new file, provided it it doesn't exist in the file system.
+ * @brief	Creates a new file, provided it it doesn't exist in the file system. Names can be up to 255 characters long.
  * @return	0 if success, -1 if the file already exists, -2 in case of error.
  */
 int createFile(char *fileName)
 {
-	/* Comprobación de que no existe un fichero con el mismo nombre */
+	/* Comprobación de la longitud del nombre: si está vacío o supera los MAX_LONGITUD_NOMBRE caracteres devuelve error, igual que createFiles */
+	if(strlen(fileName)==0 || strlen(fileName)>MAX_LONGITUD_NOMBRE){
+		return -2;
+	}
+
+	/* Comprobación de que no existe un fichero con el mismo nombre. Se hace con el cerrojo tomado, igual que la búsqueda del
+	   Inodo libre, para que dos creaciones simultáneas no creen el mismo fichero ni ocupen el mismo Inodo. */
+	pthread_mutex_lock(&mutexInodos);
 	if(findFilebyName(fileName)!=-1){
+		pthread_mutex_unlock(&mutexInodos);
 		return -1;
 	}
 
 	/* Comprobación de que el fichero tiene espacio en el disco */
 	int iNodo_libre= firstFreeInode(); 
 	if(iNodo_libre<0){
+		pthread_mutex_unlock(&mutexInodos);
 		return -2;
 	}
 
-	/* Comprobación de la longitud del nombre, si supera los 32 caracteres devuelve error */
-	if(strlen(fileName)>32){
+	/* Creación del nuevo Inodo en el sistema de ficheros. No se le asigna bloque de datos: se marca como no escrito y el
+	   bloque se reserva en la primera escritura, de forma que un fichero vacío no ocupa espacio de datos. El nombre se
+	   añade al montón de nombres; si no cabe ni compactándolo devuelve error. */
+	int posNombre= appendName(fileName);
+	if(posNombre<0){
+		pthread_mutex_unlock(&mutexInodos);
 		return -2;
 	}
-
-	/* Creación del nuevo Inodo en el sistema de ficheros */
-	strcpy(ArrayInodos[iNodo_libre].nombre, fileName);			
+	ArrayInodos[iNodo_libre].nombre= posNombre;
 	ArrayInodos[iNodo_libre].tamanyo= 0;					
-	ArrayInodos[iNodo_libre].CRCdatos= 0;					
-
-	/* Formateo del bloque de datos asociado al Inodo creado */
-	char* b_vacio= (char*) calloc(1, BLOCK_SIZE);
-	int numBloque = getNumBloque(iNodo_libre);
-	if(bwrite(DEVICE_IMAGE, numBloque, b_vacio)<0){
-		return -2;
-	}
+	memset(ArrayInodos[iNodo_libre].CRCsectores, 0, sizeof(ArrayInodos[iNodo_libre].CRCsectores));
+	ArrayInodos[iNodo_libre].sinEscribir= 1;
 
-	/* Actualización del valor del CRC del bloque de datos asociado al Inodo */
-	ArrayInodos[iNodo_libre].CRCdatos= CRC16((unsigned char*)b_vacio, BLOCK_SIZE);
+	/* Modificación del mapa de Inodos */
+	mapaInodos[iNodo_libre]=1;
 
 	/* Escritura de los metadatos a disco para que al abrir el fichero y comprobar su integridad no de fallo */
-	if(writeMetadata()<0){
+	unsigned long escritura;
+	if(writeMetadataBlocks(&escritura)<0){
+		mapaInodos[iNodo_libre]=0;
+		memset(&(ArrayInodos[iNodo_libre]),0,sizeof(Inodo));
+		releaseNames(posNombre);
+		pthread_mutex_unlock(&mutexInodos);
 		return -2;
 	}
 
-	/* Liberación de la memoria reservada para escribir el bloque en disco */
-	free(b_vacio);
+	/* Actualización del índice de nombres */
+	insertNameIndex(iNodo_libre);
+	pthread_mutex_unlock(&mutexInodos);
 
-	/* Modificación de los mapas */
-	mapaInodos[iNodo_libre]=1;
-	
+	/* Confirmación de los metadatos sin el cerrojo, para que el fsync no detenga a las demás operaciones. Si falla el fichero
+	   ya está creado y escrito en el dispositivo, pero puede no ser duradero. */
+	if(commitMetadata(escritura)<0){
+		return -2;
+	}
 	return 0;
 }
 
@@ -233,172 +569,614 @@ int createFile(char *fileName)
  */
 int removeFile(char *fileName)
 {
-	/* Comprueba que existe un fichero con ese mismo nombre */
+	/* Comprueba que existe un fichero con ese mismo nombre, con el cerrojo tomado para que no se pueda abrir mientras se borra */
+	pthread_mutex_lock(&mutexInodos);
 	int idFile= findFilebyName(fileName);
 	if(idFile<0){
+		pthread_mutex_unlock(&mutexInodos);
 		return -1;
 	}
 
 	/* Comprueba que el fichero no esté abierto */
 	if(isOpen(idFile)){
+		pthread_mutex_unlock(&mutexInodos);
 		return -2;
 	}
 
-	/* Modificación del mapa de Inodos */
+	/* Modificación de los mapas y del índice de nombres */
 	mapaInodos[idFile]=0;
+	if(!ArrayInodos[idFile].sinEscribir){
+		freeBlock(ArrayInodos[idFile].bloqueDatos);
+	}
+	removeNameIndex(idFile);
 
-	/* Borrado del iNodo del array de INodos */
+	/* Borrado del iNodo del array de INodos. Si estaba en cuarentena deja de estarlo. */
 	memset(&(ArrayInodos[idFile]),0,sizeof(Inodo)); 
+	ArrayEstados[idFile].cuarentena=0;
+	pthread_mutex_unlock(&mutexInodos);
 
 	return 0;
 }
 
 
 /*
- * @brief	Opens an existing file.
- * @return	The file descriptor if possible, -1 if file does not exist, -2 in case of error..
+ * @brief	Creates several files at once. Each result is stored in <results> with the same meaning
+ * 		as the return value of createFile. The metadata is written to disk once for the whole batch.
+ * @return	Number of files created, -2 in case of error (no file is created).
  */
-int openFile(char *fileName)
+int createFiles(char **fileNames, int numFiles, int *results)
 {
-	/* Busca el fichero que se quiere abrir */
-	int idFile= findFilebyName(fileName);
-
-	/* Comprueba si existe el fichero */
-	if(idFile<0){
-		return -1;
+	/* Comprobación de la validez de las entradas */
+	if(fileNames==NULL || results==NULL || numFiles<0){
+		return -2;
 	}
 
-	/* Comprueba si el archivo ya está abierto */
-	if(isOpen(idFile)){
+	/* Construcción de una tabla hash con los nombres existentes para resolver todos los nombres del lote en una sola pasada. Se
+	   construye con el cerrojo tomado para que los nombres no cambien hasta que termine el lote. */
+	pthread_mutex_lock(&mutexInodos);
+	int tamTabla;
+	int* tabla= buildNameTable(numFiles, &tamTabla);
+	if(tabla==NULL){
+		pthread_mutex_unlock(&mutexInodos);
 		return -2;
 	}
-	
-	/* Comprobación de la integridad del bloque de datos del fichero */ 
-	if(checkFile(fileName)<0){
+
+	/* Creación de los Inodos. Los Inodos libres se asignan en orden con un único recorrido del mapa de Inodos. */
+	int creados= 0;
+	int iNodo_libre= 0;
+	int i;
+	for(i=0; i<numFiles; i++){
+
+		/* Comprobación de la longitud del nombre */
+		if(fileNames[i]==NULL || fileNames[i][0]=='\0' || strlen(fileNames[i])>MAX_LONGITUD_NOMBRE){
+			results[i]= -2;
+			continue;
+		}
+
+		/* Comprobación de que no existe un fichero con el mismo nombre (incluidos los creados en este mismo lote) */
+		if(lookupNameTable(tabla, tamTabla, fileNames[i])!=-1){
+			results[i]= -1;
+			continue;
+		}
+
+		/* Búsqueda del siguiente Inodo libre a partir del último asignado */
+		while(iNodo_libre<s_bloque.numInodos && mapaInodos[iNodo_libre]){
+			iNodo_libre++;
+		}
+		if(iNodo_libre>=s_bloque.numInodos){
+			results[i]= -2;
+			continue;
+		}
+
+		/* Creación del nuevo Inodo sin bloque de datos, igual que en createFile */
+		int posNombre= appendName(fileNames[i]);
+		if(posNombre<0){
+			results[i]= -2;
+			continue;
+		}
+		ArrayInodos[iNodo_libre].nombre= posNombre;
+		ArrayInodos[iNodo_libre].tamanyo= 0;
+		memset(ArrayInodos[iNodo_libre].CRCsectores, 0, sizeof(ArrayInodos[iNodo_libre].CRCsectores));
+		ArrayInodos[iNodo_libre].sinEscribir= 1;
+		mapaInodos[iNodo_libre]= 1;
+		insertNameTable(tabla, tamTabla, iNodo_libre);
+		results[i]= iNodo_libre;
+		creados++;
+	}
+	free(tabla);
+
+	/* Escritura de los metadatos a disco una única vez para todo el lote. Si falla se deshacen todas las creaciones. */
+	unsigned long escritura= 0;
+	if(creados>0 && writeMetadataBlocks(&escritura)<0){
+
+		/* Los nombres del lote son los últimos del montón (compactarlo conserva el orden), desde el primero creado */
+		int inicioLote= s_bloque.finMontonNombres;
+		for(i=0; i<numFiles; i++){
+			if(results[i]>=0){
+				if(ArrayInodos[results[i]].nombre<inicioLote){
+					inicioLote= ArrayInodos[results[i]].nombre;
+				}
+				mapaInodos[results[i]]= 0;
+				memset(&(ArrayInodos[results[i]]), 0, sizeof(Inodo));
+			}
+			results[i]= -2;
+		}
+		releaseNames(inicioLote);
+		pthread_mutex_unlock(&mutexInodos);
 		return -2;
 	}
 
-	/* Comprueba que exista un descriptor sin usar */
-	int descriptor=firstFreeDesc();
-	if(descriptor<0){
-		return -2;
+	/* Reconstrucción del índice de nombres una sola vez para todo el lote */
+	if(creados>0){
+		buildNameIndex();
 	}
+	pthread_mutex_unlock(&mutexInodos);
 
-	/* Asigna al fichero el primer descriptor que no esté siendo usado */
-	ArrayDescriptores[descriptor].estado=1;
-	ArrayDescriptores[descriptor].idFichero=idFile;
-	ArrayDescriptores[descriptor].posicion=0;
+	/* Los resultados correctos se devuelven como 0, igual que en createFile */
+	for(i=0; i<numFiles; i++){
+		if(results[i]>0){
+			results[i]= 0;
+		}
+	}
 
-	/* Devuelve el descriptor asignado al fichero */
-	return descriptor;
+	/* Confirmación de los metadatos sin el cerrojo, igual que en createFile */
+	if(creados>0 && commitMetadata(escritura)<0){
+		return -2;
+	}
+	return creados;
 }
 
 /*
- * @brief	Closes a file.
- * @return	0 if success, -1 otherwise.
+ * @brief	Deletes several files at once. Each result is stored in <results> with the same meaning
+ * 		as the return value of removeFile. The metadata is written to disk once for the whole batch.
+ * @return	Number of files deleted, -2 in case of error (no file is deleted).
  */
-int closeFile(int fileDescriptor)
+int removeFiles(char **fileNames, int numFiles, int *results)
 {
-	/* Comprueba la validez de la entrada */
-	if(fileDescriptor<0 || fileDescriptor>=s_bloque.numInodos){
-		return -1;
+	/* Comprobación de la validez de las entradas */
+	if(fileNames==NULL || results==NULL || numFiles<0){
+		return -2;
 	}
 
-	/* Comprueba que el descriptor está siendo usado */
-	if(!ArrayDescriptores[fileDescriptor].estado){
-		return -1;
+	/* Copia de seguridad de los Inodos borrados para poder deshacer el lote si falla la escritura de los metadatos */
+	Inodo* copiaInodos= (Inodo*) malloc(sizeof(Inodo)*(numFiles>0 ? numFiles : 1));
+	if(copiaInodos==NULL){
+		return -2;
+	}
+
+	/* Construcción de una tabla hash con los nombres existentes para resolver todos los nombres del lote en una sola pasada,
+	   con el cerrojo tomado igual que en createFiles */
+	pthread_mutex_lock(&mutexInodos);
+	int tamTabla;
+	int* tabla= buildNameTable(0, &tamTabla);
+	if(tabla==NULL){
+		pthread_mutex_unlock(&mutexInodos);
+		free(copiaInodos);
+		return -2;
 	}
+	int borrados= 0;
+	int i;
+	for(i=0; i<numFiles; i++){
 
-	/* Obtención del número de bloque de datos del fichero que está utilizando el descriptor */
-	int numBloque= getNumBloque(ArrayDescriptores[fileDescriptor].idFichero);
+		/* Comprueba que existe un fichero con ese nombre (un nombre repetido en el lote ya no existe la segunda vez) */
+		int idFile= fileNames[i]==NULL || fileNames[i][0]=='\0' ? -1 : lookupNameTable(tabla, tamTabla, fileNames[i]);
+		if(idFile<0 || !mapaInodos[idFile]){
+			results[i]= -1;
+			continue;
+		}
 
-	/* Lectura del bloque de datos en el que se encuentra el fichero */
-	char* r_bloque= (char*) calloc(1, BLOCK_SIZE);
-	if(bread(DEVICE_IMAGE, numBloque, r_bloque)!=0){
-		return -1;
+		/* Comprueba que el fichero no esté abierto */
+		if(isOpen(idFile)){
+			results[i]= -2;
+			continue;
+		}
+
+		/* Borrado del Inodo */
+		copiaInodos[i]= ArrayInodos[idFile];
+		mapaInodos[idFile]= 0;
+		if(!ArrayInodos[idFile].sinEscribir){
+			freeBlock(ArrayInodos[idFile].bloqueDatos);
+		}
+		memset(&(ArrayInodos[idFile]), 0, sizeof(Inodo));
+		results[i]= idFile+1;
+		borrados++;
+	}
+	free(tabla);
+
+	/* Escritura de los metadatos a disco una única vez para todo el lote. Si falla se restauran todos los Inodos borrados. */
+	unsigned long escritura= 0;
+	if(borrados>0 && writeMetadataBlocks(&escritura)<0){
+		for(i=0; i<numFiles; i++){
+			if(results[i]>0){
+				ArrayInodos[results[i]-1]= copiaInodos[i];
+				mapaInodos[results[i]-1]= 1;
+				if(!copiaInodos[i].sinEscribir){
+					mapaBloques[copiaInodos[i].bloqueDatos]= 1;
+				}
+			}
+			results[i]= -2;
+		}
+		pthread_mutex_unlock(&mutexInodos);
+		free(copiaInodos);
+		return -2;
 	}
-	
-	/* Actualización del CRC del bloque de datos. El CRC es necesario que se actualice en esta función ya que en las operaciones de escritura no se actualiza.
-	   El objetivo de esto es evitar que se estén escribiendo los metadatos cada vez que se modifica un fichero, de esta forma sólo se escriben
-	   los metadatos al cerrarlo. */
-	ArrayInodos[ArrayDescriptores[fileDescriptor].idFichero].CRCdatos= CRC16((unsigned char*)r_bloque, BLOCK_SIZE);
-	if(writeMetadata()!=0){
-		return -1;
+	for(i=0; i<numFiles; i++){
+		if(results[i]>0){
+			ArrayEstados[results[i]-1].cuarentena= 0;
+		}
 	}
 
-	/* Liberación de la memoria reservada para leer el fichero de disco */
-	free(r_bloque);
+	/* Reconstrucción del índice de nombres una sola vez para todo el lote */
+	if(borrados>0){
+		buildNameIndex();
+	}
+	pthread_mutex_unlock(&mutexInodos);
+	free(copiaInodos);
 
-	/* Liberación del descriptor */
-	ArrayDescriptores[fileDescriptor].estado=0;
-	ArrayDescriptores[fileDescriptor].idFichero=-1; 	//No se puede inicializar a 0 ya que se utiliza para identificar un fichero.
-	ArrayDescriptores[fileDescriptor].posicion=0;
+	/* Los resultados correctos se devuelven como 0, igual que en removeFile */
+	for(i=0; i<numFiles; i++){
+		if(results[i]>0){
+			results[i]= 0;
+		}
+	}
 
-	return 0;
+	/* Confirmación de los metadatos sin el cerrojo, igual que en createFiles */
+	if(borrados>0 && commitMetadata(escritura)<0){
+		return -2;
+	}
+	return borrados;
 }
 
 /*
- * @brief	Reads a number of bytes from a file and stores them in a buffer.
- * @return	Number of bytes properly read, -1 in case of error.
+ * @brief	Replaces the whole contents of an existing, closed file with the <length> bytes of <buffer>.
+ * 		The new contents are written to a free block and the file is switched to it with a single
+ * 		metadata update, so after a crash the file has either its old or its new contents.
+ * @return	0 if success, -1 if the file does not exist, -2 in case of error.
  */
-int readFile(int fileDescriptor, void *buffer, int numBytes)
+int replaceFile(char *fileName, void *buffer, int length)
 {
-	/* Comprobación de la validez de las entradas */
-	if(fileDescriptor<0|| fileDescriptor>=s_bloque.numInodos){
-		return -1;
-	}
-	if(numBytes<=0){
+	/* Comprueba que existe un fichero con ese nombre */
+	int idFile= findFilebyName(fileName);
+	if(idFile<0){
 		return -1;
 	}
 
-	/* Comprobación de que el descriptor está siendo utilizado por un fichero */
-	if(!ArrayDescriptores[fileDescriptor].estado){
-		return -1;
+	/* Comprobación de la validez de las entradas */
+	if(length<0 || length>tamBloque || (buffer==NULL && length>0)){
+		return -2;
 	}
 
-	/* Obtención del identificador del fichero asociado al descriptor */
-	int idFile= ArrayDescriptores[fileDescriptor].idFichero;
-
-	/* Cálculo de la cantidad de bytes que se pueden leer del fichero */
-	if(ArrayDescriptores[fileDescriptor].posicion+numBytes>ArrayInodos[idFile].tamanyo){
-		numBytes= ArrayInodos[idFile].tamanyo - ArrayDescriptores[fileDescriptor].posicion; 
+	/* Comprueba que el fichero no esté abierto, ya que sus descriptores seguirían apuntando al contenido anterior */
+	if(isOpen(idFile)){
+		return -2;
 	}
 
-	/* Si no se pueden leer bytes del fichero devuelve 0 */
-	if(numBytes<=0){
-		return 0;
+	/* Reserva de un bloque de datos libre (bloque sombra) en el que escribir el nuevo contenido sin tocar el actual */
+	pthread_mutex_lock(&mutexInodos);
+	int bloqueSombra= allocBlock(idFile);
+	pthread_mutex_unlock(&mutexInodos);
+	if(bloqueSombra<0){
+		return -2;
 	}
 
-	/* Obtención del número de bloque en el que se encuentra el fichero a leer */
-	int numBloque= getNumBloque(idFile);
+	/* Escritura del nuevo contenido en el bloque sombra. El resto del bloque se rellena con ceros. */
+	char* b_aux= getBlockBuffer();
+	if(b_aux==NULL){
+		freeBlock(bloqueSombra);
+		return -2;
+	}
+	memcpy(b_aux, buffer, length);
+	memset(b_aux+length, 0, tamBloque-length);
+	int numBloqueSombra= getPrimerBloqueDatos()+bloqueSombra;
+	if(writeBlock(numBloqueSombra, b_aux)<0){
+		releaseBlockBuffer(b_aux);
+		freeBlock(bloqueSombra);
+		return -2;
+	}
+	updateCachedBlock(numBloqueSombra, b_aux);
 
-	/* Lectura del bloque de datos en el que se encuentra el fichero a leer */
-	char* b_aux= (char*) malloc(BLOCK_SIZE);
-	if(bread(DEVICE_IMAGE, numBloque , b_aux)<0){
-		return -1;
+	/* Con la política FS_DURABILITY_ON_COMMIT el bloque sombra tiene que estar en disco antes que los metadatos que apuntan a él */
+	if(politicaDurabilidad==FS_DURABILITY_ON_COMMIT && syncDevice()<0){
+		releaseBlockBuffer(b_aux);
+		freeBlock(bloqueSombra);
+		return -2;
 	}
 
-	/* Copia de los primeros numBytes del buffer auxiliar al buffer de lectura */
-	memmove(buffer, b_aux+ ArrayDescriptores[fileDescriptor].posicion, numBytes);
+	/* Cambio del Inodo al bloque sombra. El bloque antiguo (si lo tenía) queda libre. */
+	pthread_mutex_lock(&mutexInodos);
+	Inodo copiaInodo= ArrayInodos[idFile];
+	if(!copiaInodo.sinEscribir){
+		freeBlock(copiaInodo.bloqueDatos);
+	}
+	ArrayInodos[idFile].bloqueDatos= bloqueSombra;
+	ArrayInodos[idFile].tamanyo= length;
+	int i;
+	for(i=0; i<NUM_SECTORES_CRC; i++){
+		ArrayInodos[idFile].CRCsectores[i]= CRC16((unsigned char*)b_aux+i*tamSector, tamSector);
+	}
+	ArrayInodos[idFile].sinEscribir= 0;
+	releaseBlockBuffer(b_aux);
+
+	/* Confirmación del cambio con una única escritura de los metadatos. Si falla el fichero conserva su contenido anterior. */
+	unsigned long escritura;
+	if(writeMetadataBlocks(&escritura)<0){
+		ArrayInodos[idFile]= copiaInodo;
+		if(!copiaInodo.sinEscribir){
+			mapaBloques[copiaInodo.bloqueDatos]= 1;
+		}
+		mapaBloques[bloqueSombra]= 0;
+		pthread_mutex_unlock(&mutexInodos);
+		return -2;
+	}
 
-	/* Liberación de la memoria reservada */
-	free(b_aux);
+	/* El nuevo contenido es correcto: si el fichero estaba en cuarentena deja de estarlo */
+	ArrayEstados[idFile].cuarentena= 0;
+	pthread_mutex_unlock(&mutexInodos);
 
-	/* Actualización del puntero de posición del fichero */
-	ArrayDescriptores[fileDescriptor].posicion=ArrayDescriptores[fileDescriptor].posicion+numBytes;
-	
-	/* Devuelve el número de bytes leídos */
-	return numBytes;
+	/* Aplicación de la política de durabilidad sin el cerrojo, igual que en createFile */
+	if(commitMetadata(escritura)<0){
+		return -2;
+	}
+	return 0;
 }
 
 /*
- * @brief	Writes a number of bytes from a buffer and into a file.
- * @return	Number of bytes properly written, -1 in case of error.
+ * @brief	Opens an existing file.
+ * @return	The file descriptor if possible, -1 if file does not exist, -2 in case of error..
  */
-int writeFile(int fileDescriptor, void *buffer, int numBytes)
+int openFile(char *fileName)
+{
+	/* Busca el fichero que se quiere abrir, con el cerrojo tomado para que no se pueda borrar antes de abrirlo */
+	pthread_mutex_lock(&mutexInodos);
+	int idFile= findFilebyName(fileName);
+
+	/* Comprueba si existe el fichero */
+	if(idFile<0){
+		pthread_mutex_unlock(&mutexInodos);
+		return -1;
+	}
+
+	/* La integridad del bloque de datos no se comprueba al abrir: cada lectura verifica el CRC de los sectores que toca y la
+	   verificación en segundo plano pone en cuarentena los ficheros que encuentra corruptos, que no se pueden abrir */
+	if(ArrayEstados[idFile].cuarentena){
+		pthread_mutex_unlock(&mutexInodos);
+		return -2;
+	}
+
+	/* Comprueba que exista un descriptor sin usar. Se elige y se marca como usado con el cerrojo tomado para que dos aperturas
+	   simultáneas no obtengan el mismo descriptor. */
+	int descriptor=firstFreeDesc();
+	if(descriptor<0){
+		pthread_mutex_unlock(&mutexInodos);
+		return -2;
+	}
+
+	/* Asigna al fichero el primer descriptor que no esté siendo usado, con su propio puntero de posición */
+	linkDesc(descriptor, idFile);
+	ArrayDescriptores[descriptor].estado=1;
+	ArrayDescriptores[descriptor].posicion=0;
+	ArrayDescriptores[descriptor].finLectura=-1;
+	ArrayDescriptores[descriptor].mapeado=0;
+	pthread_mutex_unlock(&mutexInodos);
+
+	/* Devuelve el descriptor asignado al fichero */
+	return descriptor;
+}
+
+/*
+ * @brief	Closes a file.
+ * @return	0 if success, -1 otherwise.
+ */
+int closeFile(int fileDescriptor)
+{
+	/* Comprueba la validez de la entrada */
+	if(fileDescriptor<0 || fileDescriptor>=numDescriptores){
+		return -1;
+	}
+
+	/* Comprueba que el descriptor está siendo usado */
+	if(!ArrayDescriptores[fileDescriptor].estado){
+		return -1;
+	}
+
+	/* Si el fichero no se ha modificado desde que se calcularon sus CRC (por ejemplo, si sólo se ha leído o no se ha escrito nunca)
+	   no hay CRC ni metadatos que actualizar. El CRC es necesario que se actualice en esta función ya que en las operaciones de escritura
+	   no se actualiza: así sólo se escriben los metadatos al cerrar el fichero y no cada vez que se modifica. */
+	int idFile= ArrayDescriptores[fileDescriptor].idFichero;
+	if(ArrayEstados[idFile].sectoresModificados && !ArrayInodos[idFile].sinEscribir){
+		if(commitModifiedSectors(idFile)!=0){
+			return -1;
+		}
+		if(politicaDurabilidad==FS_DURABILITY_ON_CLOSE && syncDevice()!=0){
+			return -1;
+		}
+	}
+
+	/* Liberación del descriptor y de su proyección (si la tiene), con el cerrojo tomado igual que al asignarlo */
+	pthread_mutex_lock(&mutexInodos);
+	unlinkDesc(fileDescriptor);
+	ArrayDescriptores[fileDescriptor].mapeado=0;
+	ArrayDescriptores[fileDescriptor].estado=0;
+	ArrayDescriptores[fileDescriptor].posicion=0;
+	pthread_mutex_unlock(&mutexInodos);
+
+	return 0;
+}
+
+/*
+ * @brief	Makes the data and metadata of an open file durable on the device.
+ * @return	0 if success, -1 otherwise.
+ */
+int syncFile(int fileDescriptor)
+{
+	/* Comprueba la validez de la entrada */
+	if(fileDescriptor<0 || fileDescriptor>=numDescriptores){
+		return -1;
+	}
+	if(!ArrayDescriptores[fileDescriptor].estado){
+		return -1;
+	}
+
+	/* Actualización del CRC de los sectores modificados y de los metadatos, como al cerrar el fichero */
+	int idFile= ArrayDescriptores[fileDescriptor].idFichero;
+	if(ArrayEstados[idFile].sectoresModificados && !ArrayInodos[idFile].sinEscribir){
+		if(commitModifiedSectors(idFile)!=0){
+			return -1;
+		}
+	}
+
+	/* Un único fsync lleva a disco los datos y los metadatos */
+	return syncDevice();
+}
+
+/*
+ * @brief	Makes the data and metadata of every file durable on the device.
+ * @return	0 if success, -1 otherwise.
+ */
+int syncFS(void)
+{
+	/* Actualización del CRC de los sectores modificados de todos los ficheros abiertos */
+	int i;
+	for(i=0; i<s_bloque.numInodos; i++){
+		if(mapaInodos[i] && ArrayEstados[i].sectoresModificados && !ArrayInodos[i].sinEscribir){
+			if(commitModifiedSectors(i)!=0){
+				return -1;
+			}
+		}
+	}
+
+	/* Escritura de los metadatos (también los de las operaciones que no los escriben, como removeFile) y fsync del dispositivo */
+	if(writeMetadata()!=0){
+		return -1;
+	}
+	return syncDevice();
+}
+
+/*
+ * @brief	Gets the block buffer allocation counters since the file system was mounted.
+ * @return	0 if success, -1 otherwise.
+ */
+int getAllocStats(FSAllocStats *stats)
+{
+	if(stats==NULL || memoriaPool==NULL){
+		return -1;
+	}
+	pthread_mutex_lock(&mutexPool);
+	stats->bufferRequests= peticionesBuffer;
+	stats->heapAllocations= reservasHeap;
+	stats->poolBuffers= TAM_POOL_BUFFERS;
+	stats->buffersInUse= TAM_POOL_BUFFERS-numBuffersLibres;
+	pthread_mutex_unlock(&mutexPool);
+	return 0;
+}
+
+/*
+ * @brief	Gets the counters of the background scrubber since the file system was mounted.
+ * @return	0 if success, -1 if the scrubber is not running.
+ */
+int getScrubStats(FSScrubStats *stats)
+{
+	if(stats==NULL){
+		return -1;
+	}
+	pthread_mutex_lock(&mutexVerificacion);
+	int activa= verificacionActiva;
+	if(activa){
+		*stats= estadisticasVerificacion;
+	}
+	pthread_mutex_unlock(&mutexVerificacion);
+	return activa ? 0 : -1;
+}
+
+/*
+ * @brief	Reads a number of bytes from a file and stores them in a buffer.
+ * @return	Number of bytes properly read, -1 in case of error.
+ */
+int readFile(int fileDescriptor, void *buffer, int numBytes)
+{
+	/* Comprobación de la validez de las entradas */
+	if(fileDescriptor<0|| fileDescriptor>=numDescriptores){
+		return -1;
+	}
+	if(numBytes<=0){
+		return -1;
+	}
+
+	/* Comprobación de que el descriptor está siendo utilizado por un fichero */
+	if(!ArrayDescriptores[fileDescriptor].estado){
+		return -1;
+	}
+
+	/* Obtención del identificador del fichero asociado al descriptor */
+	int idFile= ArrayDescriptores[fileDescriptor].idFichero;
+
+	/* Cálculo de la cantidad de bytes que se pueden leer del fichero */
+	if(ArrayDescriptores[fileDescriptor].posicion+numBytes>(int) ArrayInodos[idFile].tamanyo){
+		numBytes= ArrayInodos[idFile].tamanyo - ArrayDescriptores[fileDescriptor].posicion; 
+	}
+
+	/* Si no se pueden leer bytes del fichero devuelve 0 */
+	if(numBytes<=0){
+		return 0;
+	}
+
+	/* Obtención del número de bloque en el que se encuentra el fichero a leer */
+	int numBloque= getNumBloque(idFile);
+
+	/* Si el bloque de datos no se ha escrito nunca su contenido son ceros y no es necesario leerlo de disco */
+	if(ArrayInodos[idFile].sinEscribir){
+		memset(buffer, 0, numBytes);
+	}
+	else{
+		/* Cálculo de los sectores que contienen los bytes a leer */
+		int posicion= ArrayDescriptores[fileDescriptor].posicion;
+		int primerSector= posicion/tamSector;
+		int numSectores= (posicion+numBytes-1)/tamSector - primerSector + 1;
+
+		/* Lectura de los sectores completos, sirviéndolos desde la caché de lectura si el bloque ya está cargado o precargado,
+		   y comprobación del CRC de esos sectores únicamente. Los sectores escritos desde la apertura no se comprueban porque
+		   su CRC no se actualiza hasta cerrar el fichero. */
+		char* b_aux= getBlockBuffer();
+		if(b_aux==NULL){
+			return -1;
+		}
+		if(readDataBlock(numBloque, primerSector*tamSector, b_aux, numSectores*tamSector)<0){
+			releaseBlockBuffer(b_aux);
+			return -1;
+		}
+		if(verifySectors(idFile, b_aux, primerSector, numSectores)<0){
+			releaseBlockBuffer(b_aux);
+			return -1;
+		}
+
+		/* Copia de los numBytes pedidos al buffer de lectura */
+		memmove(buffer, b_aux+posicion-primerSector*tamSector, numBytes);
+		releaseBlockBuffer(b_aux);
+	}
+
+	/* Detección de accesos secuenciales. Cada fichero ocupa un único bloque, por lo que la precarga se hace sobre los bloques
+	   siguientes en disco, que el asignador reserva a los ficheros con nombres vecinos. La ventana se duplica con cada salto al bloque siguiente, se anula
+	   con los saltos aleatorios y se mantiene mientras se sigue leyendo el mismo bloque. La ventana y el último bloque leído son
+	   comunes a todos los descriptores, por lo que se actualizan y se usan con el cerrojo de los Inodos. */
+	int secuencial= ArrayDescriptores[fileDescriptor].posicion==ArrayDescriptores[fileDescriptor].finLectura;
+	pthread_mutex_lock(&mutexInodos);
+	if(numBloque==ultimoBloqueLeido+1){
+		ventanaReadahead= ventanaReadahead ? ventanaReadahead*2 : 1;
+		if(ventanaReadahead>READAHEAD_MAX){
+			ventanaReadahead=READAHEAD_MAX;
+		}
+	}
+	else if(numBloque!=ultimoBloqueLeido){
+		ventanaReadahead=0;
+	}
+	ultimoBloqueLeido= numBloque;
+
+	/* Si el descriptor ha recorrido secuencialmente el fichero hasta el final se anticipa la lectura del fichero siguiente */
+	int ventana= ventanaReadahead;
+	if(!ventana && secuencial && ArrayDescriptores[fileDescriptor].posicion+numBytes==(int) ArrayInodos[idFile].tamanyo){
+		ventana= 1;
+	}
+	if(ventana>0){
+		prefetchFiles(idFile, ventana);
+	}
+	pthread_mutex_unlock(&mutexInodos);
+
+	/* Actualización del puntero de posición del fichero */
+	ArrayDescriptores[fileDescriptor].posicion=ArrayDescriptores[fileDescriptor].posicion+numBytes;
+	ArrayDescriptores[fileDescriptor].finLectura=ArrayDescriptores[fileDescriptor].posicion;
+	
+	/* Devuelve el número de bytes leídos */
+	return numBytes;
+}
+
+/*
+ * @brief	Writes a number of bytes from a buffer and into a file.
+ * @return	Number of bytes properly written, -1 in case of error.
+ */
+int writeFile(int fileDescriptor, void *buffer, int numBytes)
 {
 	/* Comprobación de la validez de las entradas */
-	if(fileDescriptor<0 || fileDescriptor>=s_bloque.numInodos){
+	if(fileDescriptor<0 || fileDescriptor>=numDescriptores){
 		return -1;
 	}
 	if(numBytes<=0){
@@ -411,8 +1189,8 @@ int writeFile(int fileDescriptor, void *buffer, int numBytes)
 	}
 	
 	/* Comprobación de la cantidad de bytes que se pueden escribir en el fichero */
-	if(ArrayDescriptores[fileDescriptor].posicion+numBytes>BLOCK_SIZE){
-		numBytes = BLOCK_SIZE - ArrayDescriptores[fileDescriptor].posicion;
+	if(ArrayDescriptores[fileDescriptor].posicion+numBytes>tamBloque){
+		numBytes = tamBloque - ArrayDescriptores[fileDescriptor].posicion;
 	}
 	/* Si no se pueden escribir más bytes en el fichero devuelve 0 */
 	if(numBytes<=0){
@@ -422,12 +1200,42 @@ int writeFile(int fileDescriptor, void *buffer, int numBytes)
 	/* Obtención del identificador del fichero asociado al descriptor */
 	int idFile= ArrayDescriptores[fileDescriptor].idFichero;
 
-	/* Obtención del número de bloque en el que se encuentra el fichero a escribir */
-	int numBloque= getNumBloque(idFile);
+	/* Obtención del número de bloque en el que se encuentra el fichero a escribir. Si el fichero no se ha escrito nunca no
+	   tiene bloque de datos: se le reserva uno libre, que no se le asigna hasta que la escritura termina con éxito. En modo
+	   registro el contenido modificado tampoco se escribe en el sitio sino en un bloque nuevo de la cabeza del registro,
+	   salvo si el fichero está proyectado con mapFile (la proyección apunta al bloque actual) o el registro está lleno. */
+	int primeraEscritura= ArrayInodos[idFile].sinEscribir;
+	int bloqueNuevo= -1;
+	pthread_mutex_lock(&mutexInodos);
+	if(primeraEscritura){
+		bloqueNuevo= allocBlock(idFile);
+	}
+	else if(s_bloque.modoRegistro && !isMapped(idFile)){
+		bloqueNuevo= appendLogBlock(-1);
+	}
+	pthread_mutex_unlock(&mutexInodos);
+	if(primeraEscritura && bloqueNuevo<0){
+		return -1;
+	}
+	int numBloque= bloqueNuevo>=0 ? getPrimerBloqueDatos()+bloqueNuevo : getNumBloque(idFile);
 
-	/* Lectura del bloque de datos en el que se encuentra el fichero sobre el que se quiere escribir */
-	char* b_aux= (char*) malloc(BLOCK_SIZE);
-	if(bread(DEVICE_IMAGE, numBloque , b_aux)<0){
+	/* Lectura del bloque de datos en el que se encuentra el fichero sobre el que se quiere escribir. Si el bloque no se ha
+	   escrito nunca no se lee de disco: se parte de un bloque a ceros que se materializa con esta escritura. */
+	char* b_aux= getBlockBuffer();
+	if(b_aux==NULL){
+		if(bloqueNuevo>=0){
+			freeBlock(bloqueNuevo);
+		}
+		return -1;
+	}
+	if(primeraEscritura){
+		memset(b_aux, 0, tamBloque);
+	}
+	else if(readDataBlock(getNumBloque(idFile), 0, b_aux, tamBloque)<0){
+		releaseBlockBuffer(b_aux);
+		if(bloqueNuevo>=0){
+			freeBlock(bloqueNuevo);
+		}
 		return -1;
 	}
 
@@ -436,20 +1244,43 @@ int writeFile(int fileDescriptor, void *buffer, int numBytes)
 	memmove(b_aux+ ArrayDescriptores[fileDescriptor].posicion, buffer, numBytes);
 
 	/* Escritura del fichero modificado a disco */
-	if(bwrite(DEVICE_IMAGE, numBloque , b_aux)<0){
+	if(writeBlock(numBloque , b_aux)<0){
+		releaseBlockBuffer(b_aux);
+		if(bloqueNuevo>=0){
+			freeBlock(bloqueNuevo);
+		}
 		return -1;
 	}
+	updateCachedBlock(numBloque, b_aux);
 
-	/* Liberación de la memoria reservada */
-	free(b_aux);
+	/* Liberación del buffer */
+	releaseBlockBuffer(b_aux);
+
+	/* El bloque de datos ya está materializado en disco. El cambio se persiste en los metadatos al cerrar el fichero. Si se ha
+	   escrito en un bloque nuevo se asigna al fichero; el bloque anterior (en modo registro) sigue ocupado hasta que se escriben
+	   los metadatos que ya no lo referencian. Si es la primera escritura se ha escrito el bloque completo, por lo que hay que
+	   calcular el CRC de todos sus sectores. */
+	pthread_mutex_lock(&mutexInodos);
+	if(bloqueNuevo>=0){
+		if(!primeraEscritura){
+			retireLogBlock(ArrayInodos[idFile].bloqueDatos);
+		}
+		ArrayInodos[idFile].bloqueDatos= bloqueNuevo;
+		ArrayInodos[idFile].sinEscribir= 0;
+	}
+	if(primeraEscritura){
+		markModifiedSectors(idFile, 0, tamBloque);
+	}
+	markModifiedSectors(idFile, ArrayDescriptores[fileDescriptor].posicion, numBytes);
 
 	/* Actualización del puntero de posición del fichero */
 	ArrayDescriptores[fileDescriptor].posicion=ArrayDescriptores[fileDescriptor].posicion+numBytes;
 
 	/* Actualización del tamaño del fichero */
-	if(ArrayDescriptores[fileDescriptor].posicion>ArrayInodos[idFile].tamanyo){
+	if(ArrayDescriptores[fileDescriptor].posicion>(int) ArrayInodos[idFile].tamanyo){
 		ArrayInodos[idFile].tamanyo=ArrayDescriptores[fileDescriptor].posicion;
 	}
+	pthread_mutex_unlock(&mutexInodos);
 	
 	/* Devuelve el número de bytes escritos */
 	return numBytes;
@@ -462,7 +1293,7 @@ int writeFile(int fileDescriptor, void *buffer, int numBytes)
 int lseekFile(int fileDescriptor, int whence, long offset)
 {
 	/* Comprobación de la validez de las entradas */
-	if(fileDescriptor<0 || fileDescriptor>=s_bloque.numInodos){
+	if(fileDescriptor<0 || fileDescriptor>=numDescriptores){
 		return -1;
 	}
 
@@ -516,49 +1347,14 @@ int checkFS(void)
 {
 	/* Comprueba que no haya ningún fichero abierto */
 	int i;
-	for(i=0; i<s_bloque.numInodos; i++){
+	for(i=0; i<numDescriptores; i++){
 		if(ArrayDescriptores[i].estado){
 			return -2;
 		}
 	}
 
-	/* Lectura del primer bloque de disco para obtener los metadatos */
-	char* r_bloque= (char *) calloc(1, BLOCK_SIZE);
-	if(bread(DEVICE_IMAGE, 0 , r_bloque)<0){
-		return -2;
-	}
-
-	/* Obtención del valor de CRCMetadata guardado en el disco */
-	uint16_t crcDisco;
-	memcpy(&crcDisco, r_bloque + sizeof(s_bloque) + sizeof(mapaInodos) , sizeof(crcDisco));
-	
-	/* Copia de los metadatos guardados en disco a un buffer auxiliar. Puesto que el CRC se encuentra entre el mapa de Inodos y los Inodos
-	   se tiene que copiar el contenido por partes para no copiar al buffer el CRC de los metadatos. */
-	int numBytesMetadatos= sizeof(s_bloque) + sizeof(mapaInodos) + sizeof(Inodo)*s_bloque.numInodos;
-	unsigned char* b_aux= (unsigned char *) calloc(1, numBytesMetadatos);
-	memcpy(b_aux, r_bloque, sizeof(s_bloque) + sizeof(mapaInodos));
-	memcpy(b_aux+sizeof(s_bloque) + sizeof(mapaInodos), r_bloque + sizeof(s_bloque) + sizeof(mapaInodos) + sizeof(CRCmetadata), iNodosPrimerBloque*sizeof(Inodo));
-	if(iNodosExtra>0){
-		if(bread(DEVICE_IMAGE, 1 , r_bloque)<0){
-			return -2;
-		}
-		memcpy(b_aux + sizeof(s_bloque) + sizeof(mapaInodos) + iNodosPrimerBloque*sizeof(Inodo), r_bloque, iNodosExtra*sizeof(Inodo));
-	}
-
-	/* Aplicación de la función CRC a los metadatos obtenidos del disco */
-	uint16_t crcMetadatos = CRC16(b_aux, numBytesMetadatos);
-
-	/* Liberación de la memoria reservada */
-	free(b_aux);
-	free(r_bloque);
-
-	/* Comparación entre el CRC obtenido del disco y el CRC calculado a partir de los metadatos de disco */
-	if(crcDisco==crcMetadatos){
-		return 0;
-	}
-
-	/* Si llega a este punto los metadatos están corruptos, devuelve error. */
-	return -1;
+	/* Comprobación del CRC de los metadatos guardados en disco */
+	return verifyMetadata();
 }
 
 /*
@@ -575,47 +1371,58 @@ int checkFile(char *fileName)
 		return -2;
 	}
 
-	/* Copia de los Inodos del disco a memoria */
-	char* r_bloque= (char *) calloc(1, BLOCK_SIZE);
-	Inodo* vectorInodos= (Inodo *) calloc(1, sizeof(Inodo)*(iNodosPrimerBloque+iNodosExtra));
-	if(bread(DEVICE_IMAGE, 0, r_bloque)<0){
+	/* Búsqueda del Inodo del fichero entre los Inodos del disco, recorriéndolos directamente sobre los bloques de metadatos y
+	   comparando los nombres en el montón de nombres del disco, que puede continuar en el segundo bloque */
+	char* r_bloque= getBlockBuffer();
+	char* r_segundo= bloquesMetadatos>1 ? getBlockBuffer() : NULL;
+	if(r_bloque==NULL || (bloquesMetadatos>1 && r_segundo==NULL) || readBlock(0, r_bloque)<0 ||
+	   (r_segundo!=NULL && readInodeBlock(1, r_segundo)<0)){
+		releaseBlockBuffer(r_bloque);
+		releaseBlockBuffer(r_segundo);
 		return -2;
 	}
-	memcpy(vectorInodos, r_bloque+sizeof(s_bloque)+sizeof(mapaInodos)+sizeof(CRCmetadata), sizeof(Inodo)*(iNodosPrimerBloque));
-	
-	if(iNodosExtra>0){
-		if(bread(DEVICE_IMAGE, 1, r_bloque)<0){
-			return -2;
-		}
-		memcpy(vectorInodos+sizeof(Inodo)*iNodosPrimerBloque, r_bloque, sizeof(Inodo)*iNodosExtra );
-	}
-
-	/* Obtención del Inodo que contiene la información del fichero con el nombre que se pasa por parámetro */
-	uint16_t CRCbloqueDatos;
-	int numBloqueDatos;
+	uint16_t CRCsectores[NUM_SECTORES_CRC];
+	int numBloqueDatos= -1;
+	int sinEscribir= 0;
+	Inodo inodo;
 	int i;
 	for(i=0; i<s_bloque.numInodos ; i++){
+		memcpy(&inodo, r_bloque+sizeof(s_bloque)+sizeof(mapaInodos)+sizeof(mapaBloques)+sizeof(CRCmetadata)+sizeof(Inodo)*i, sizeof(Inodo));
+
 		/* Cuando encuentra el Inodo obtiene su CRC de bloque de datos y el número de bloque */
-		if(!strcmp(fileName, vectorInodos[i].nombre)){
-			CRCbloqueDatos=vectorInodos[i].CRCdatos;
-			numBloqueDatos=getNumBloque(i);
+		if(r_bloque[sizeof(s_bloque)+i] && compareDiskName(fileName, r_bloque, r_segundo, inodo.nombre)){
+			memcpy(CRCsectores, inodo.CRCsectores, sizeof(CRCsectores));
+			numBloqueDatos=getPrimerBloqueDatos()+inodo.bloqueDatos;
+			sinEscribir=inodo.sinEscribir;
 		}
 	}
+	releaseBlockBuffer(r_segundo);
+
+	/* Un fichero cuyo bloque de datos no se ha escrito nunca no tiene contenido que verificar. Si el fichero no está en los
+	   metadatos del disco no se puede verificar. */
+	if(sinEscribir || numBloqueDatos<0){
+		releaseBlockBuffer(r_bloque);
+		return sinEscribir ? 0 : -2;
+	}
 
 	/* Lectura del bloque de datos del fichero */
-	if(bread(DEVICE_IMAGE, numBloqueDatos, r_bloque)<0){
+	if(readBlock(numBloqueDatos, r_bloque)<0){
+		releaseBlockBuffer(r_bloque);
 		return -2;
 	}
 
-	/* Obtención del CRC del bloque de datos del fichero */
-	uint16_t CRCbloqueDatos2 = CRC16((unsigned char*)r_bloque, BLOCK_SIZE);
+	/* Compara el valor de CRC de cada sector obtenido del Inodo con el CRC calculado a partir del bloque de datos del fichero */
+	int corrupto= 0;
+	for(i=0; i<NUM_SECTORES_CRC; i++){
+		if(CRCsectores[i]!=CRC16((unsigned char*)r_bloque+i*tamSector, tamSector)){
+			corrupto= 1;
+		}
+	}
 
-	/* Liberación de la memoria reservada */
-	free(r_bloque);
-	free(vectorInodos);
+	/* Liberación del buffer */
+	releaseBlockBuffer(r_bloque);
 
-	/* Compara el valor de CRC obtenido del Inodo con el CRC calculado a partir del bloque de datos del fichero */
-	if(CRCbloqueDatos==CRCbloqueDatos2){
+	if(!corrupto){
 		return 0;
 	}	
 
@@ -624,69 +1431,173 @@ int checkFile(char *fileName)
 }
 
 /*
- * @brief 	Busca en el sistema de ficheros un fichero con el nombre recibido por parámetro.
- * @return 	El id del fichero si lo encuentra, -1 si no encuentra un fichero con ese nombre.
+ * @brief	Obtains the attributes of a file without opening it or accessing the device.
+ * @return	0 if success, -1 if the file does not exist, -2 in case of error.
  */
-int findFilebyName(char *fileName){
-	int i;
-	for(i=0; i<s_bloque.numInodos ; i++){
-		if(!strcmp(fileName, ArrayInodos[i].nombre)){
-			return i;
-		}
+int statFile(char *fileName, FileStat *info)
+{
+	/* Comprobación de la validez de las entradas */
+	if(fileName==NULL || info==NULL){
+		return -2;
 	}
-	return -1;
-}
 
-/*
- * @brief 	Busca el primer Inodo libre de la lista de iNodos.
- * @return 	Devuelve el identificador del primer iNodo libre (si es que existe), -1 si no hay ninguno libre (el sistema de ficheros está lleno).
- */
-int firstFreeInode(){
-	int i;
-	for(i=0; i<s_bloque.numInodos; i++){
-		if(!mapaInodos[i]){
-			return i;
-		}
+	/* Busca el fichero en el índice de nombres */
+	pthread_mutex_lock(&mutexInodos);
+	int idFile= findFilebyName(fileName);
+	if(idFile<0){
+		pthread_mutex_unlock(&mutexInodos);
+		return -1;
 	}
-	return -1;
+
+	/* Copia de los atributos del Inodo */
+	info->name= getFileName(idFile);
+	info->size= ArrayInodos[idFile].tamanyo;
+	info->written= !ArrayInodos[idFile].sinEscribir;
+	pthread_mutex_unlock(&mutexInodos);
+	return 0;
 }
 
 /*
- * @brief 	Busca el primer descriptor libre de la lista de descriptores.
- * @return 	Devuelve el primer descriptor sin usar (si es que existe), -1 si no hay ningún descriptor sin usar.
+ * @brief	Calls <callback> with the attributes of every file whose name starts with <prefix>, in name order.
+ * 		A NULL or empty prefix lists every file. Listing stops if the callback returns a value other than 0.
+ * 		The callback must not create or remove files. No device access is performed.
+ * @return	Number of files passed to the callback, -1 in case of error.
  */
-int firstFreeDesc(){
-	int i;
-	for(i=0;i<s_bloque.numInodos; i++){
-		if(!ArrayDescriptores[i].estado){
-			return i;
-		}
+int listFiles(char *prefix, int (*callback)(const FileStat *info, void *arg), void *arg)
+{
+	/* Comprobación de la validez de las entradas */
+	if(callback==NULL){
+		return -1;
+	}
+	if(prefix==NULL){
+		prefix= "";
 	}
-	return -1;
-}
 
-/*
- * @brief 	Comprueba si un fichero está abierto.
- * @return 	Devuelve 1 si el fichero recibido por parámetro está abierto, 0 si no lo está.
- */
-int isOpen(int idFile){
+	/* Los nombres con un prefijo común son consecutivos en el índice: se busca el primero y se recorre hasta que deja de coincidir.
+	   El índice se recorre con el cerrojo tomado para que no cambie durante el listado. */
+	size_t longPrefijo= strlen(prefix);
+	int listados= 0;
 	int i;
-	for(i=0;i<s_bloque.numInodos; i++){
-		if(idFile==ArrayDescriptores[i].idFichero){
-			return 1;
+	pthread_mutex_lock(&mutexInodos);
+	for(i=searchNameIndex(prefix); i<numIndiceNombres; i++){
+		Inodo* iNodo= &(ArrayInodos[indiceNombres[i]]);
+		char* nombre= getFileName(indiceNombres[i]);
+		if(strncmp(nombre, prefix, longPrefijo)){
+			break;
+		}
+
+		FileStat info;
+		info.name= nombre;
+		info.size= iNodo->tamanyo;
+		info.written= !iNodo->sinEscribir;
+		listados++;
+		if(callback(&info, arg)){
+			break;
 		}
 	}
-	return 0;
+	pthread_mutex_unlock(&mutexInodos);
+	return listados;
 }
 
 /*
- * @brief 	Devuelve el descriptor asociado a un fichero.
- * @return 	Descriptor asociado al fichero con identificador idFile. -1 en caso de que ese fichero no tenga asociado un descriptor.
+ * @brief	Maps the contents of an open file for read-only access without copying them.
+ * 		The CRC of the file is verified once, when it is mapped. The pointer stays valid until
+ * 		unmapFile or closeFile is called on the descriptor.
+ * @return	Pointer to the file contents and its size in <length>, NULL in case of error.
  */
-int findDescFile(int idFile){
-	int i;
-	for(i=0;i<s_bloque.numInodos; i++){
-		if(ArrayDescriptores[i].idFichero==idFile){
+const void *mapFile(int fileDescriptor, int *length)
+{
+	/* Comprobación de la validez de las entradas */
+	if(fileDescriptor<0 || fileDescriptor>=numDescriptores || length==NULL){
+		return NULL;
+	}
+
+	/* Comprobación de que el descriptor tiene asociado un fichero */
+	if(!ArrayDescriptores[fileDescriptor].estado){
+		return NULL;
+	}
+
+	/* Obtención del identificador del fichero asociado al descriptor */
+	int idFile= ArrayDescriptores[fileDescriptor].idFichero;
+
+	/* Si el bloque de datos no se ha escrito nunca el contenido del fichero son ceros */
+	const char* contenido= bloqueCeros;
+	if(!ArrayInodos[idFile].sinEscribir){
+
+		/* Proyección de la imagen que contiene el bloque de datos (sólo se realiza la primera vez) */
+		int bloqueDispositivo;
+		int dispositivo= locateBlock(getNumBloque(idFile), &bloqueDispositivo);
+		size_t tamImagen;
+		char* imagen= mapDeviceImage(dispositivo, &tamImagen);
+		if(imagen==NULL){
+			return NULL;
+		}
+
+		/* Comprobación de que el bloque de datos del fichero está dentro de la imagen proyectada */
+		long inicioBloque= (long) bloqueDispositivo*tamBloque;
+		if(inicioBloque+tamBloque>(long) tamImagen){
+			return NULL;
+		}
+		contenido= imagen+inicioBloque;
+
+		/* Comprobación de la integridad del bloque de datos directamente sobre la proyección. Los sectores escritos desde que se
+		   abrió el fichero no se comprueban porque su CRC no se actualiza hasta cerrarlo. */
+		if(verifySectors(idFile, (char*)contenido, 0, NUM_SECTORES_CRC)<0){
+			return NULL;
+		}
+	}
+
+	/* Devuelve el puntero al contenido del fichero y su tamaño */
+	ArrayDescriptores[fileDescriptor].mapeado=1;
+	*length= ArrayInodos[idFile].tamanyo;
+	return contenido;
+}
+
+/*
+ * @brief	Releases a mapping obtained with mapFile.
+ * @return	0 if success, -1 otherwise.
+ */
+int unmapFile(int fileDescriptor)
+{
+	/* Comprobación de la validez de las entradas */
+	if(fileDescriptor<0 || fileDescriptor>=numDescriptores){
+		return -1;
+	}
+
+	/* Comprobación de que el descriptor tiene una proyección activa */
+	if(!ArrayDescriptores[fileDescriptor].estado || !ArrayDescriptores[fileDescriptor].mapeado){
+		return -1;
+	}
+
+	/* La imagen del dispositivo permanece proyectada mientras el sistema de ficheros esté montado para que las siguientes
+	   proyecciones no tengan coste. Sólo se libera la proyección del descriptor. */
+	ArrayDescriptores[fileDescriptor].mapeado=0;
+	return 0;
+}
+
+/*
+ * @brief 	Busca en el sistema de ficheros un fichero con el nombre recibido por parámetro mediante búsqueda binaria en el índice de nombres.
+ * @return 	El id del fichero si lo encuentra, -1 si no encuentra un fichero con ese nombre.
+ */
+int findFilebyName(char *fileName){
+	int idFile= -1;
+	pthread_mutex_lock(&mutexInodos);
+	int pos= searchNameIndex(fileName);
+	if(pos<numIndiceNombres && !strcmp(fileName, getFileName(indiceNombres[pos]))){
+		idFile= indiceNombres[pos];
+	}
+	pthread_mutex_unlock(&mutexInodos);
+	return idFile;
+}
+
+/*
+ * @brief 	Busca el primer Inodo libre de la lista de iNodos.
+ * @return 	Devuelve el identificador del primer iNodo libre (si es que existe), -1 si no hay ninguno libre (el sistema de ficheros está lleno).
+ */
+int firstFreeInode(){
+	int i;
+	for(i=0; i<s_bloque.numInodos; i++){
+		if(!mapaInodos[i]){
 			return i;
 		}
 	}
@@ -694,60 +1605,1958 @@ int findDescFile(int idFile){
 }
 
 /*
- * @brief 	Calcula el número de bloque correspondiente a un fichero con identificador idFile
- * @return 	Número de bloque de datos correspondiente al fichero con identificador idFile
+ * @brief 	Busca en el mapa de bloques el primer bloque de datos libre a partir del bloque desde. Al llegar al último bloque
+ * 		continúa por el principio.
+ * @return 	Devuelve el primer bloque de datos libre (relativo al primer bloque de datos), -1 si no hay ninguno libre.
+ */
+int firstFreeBlock(int desde){
+	int i;
+	for(i=0; i<s_bloque.numBloquesDatos; i++){
+		int bloque= (desde+i)%s_bloque.numBloquesDatos;
+		if(!mapaBloques[bloque]){
+			return bloque;
+		}
+	}
+	return -1;
+}
+
+/*
+ * @brief 	Reserva un bloque de datos libre para el fichero idFile. Se busca a continuación del bloque del fichero anterior en
+ * 		orden de nombre que tenga bloque asignado, de forma que los ficheros con nombres relacionados quedan juntos en disco y
+ * 		un recorrido en orden de nombre lee bloques consecutivos. En modo registro se reserva en la cabeza del registro. El bloque
+ * 		se marca como ocupado pero no se asigna al Inodo.
+ * @return 	Devuelve el bloque reservado (relativo al primer bloque de datos), -1 si no hay ninguno libre.
+ */
+int allocBlock(int idFile){
+	/* En modo registro los bloques se reservan siempre en la cabeza del registro */
+	if(s_bloque.modoRegistro){
+		return appendLogBlock(-1);
+	}
+
+	int objetivo= 0;
+	int posicion= searchNameIndex(getFileName(idFile));
+	while(--posicion>=0){
+		int anterior= indiceNombres[posicion];
+		if(!ArrayInodos[anterior].sinEscribir){
+			objetivo= (ArrayInodos[anterior].bloqueDatos+1)%s_bloque.numBloquesDatos;
+			break;
+		}
+	}
+	int bloque= firstFreeBlock(objetivo);
+	if(bloque>=0){
+		mapaBloques[bloque]= 1;
+	}
+	return bloque;
+}
+
+/*
+ * @brief 	Libera un bloque de datos en el mapa de bloques. El cambio se persiste con la siguiente escritura de los metadatos.
+ */
+void freeBlock(int bloque){
+	pthread_mutex_lock(&mutexInodos);
+	mapaBloques[bloque]= 0;
+	bloquesPorLiberar[bloque]= 1;
+	pthread_mutex_unlock(&mutexInodos);
+}
+
+/*
+ * @brief 	Devuelve el primer descriptor de la lista de descriptores libres.
+ * @return 	Devuelve el primer descriptor sin usar (si es que existe), -1 si no hay ningún descriptor sin usar.
+ */
+int firstFreeDesc(){
+	return primerDescLibre;
+}
+
+/*
+ * @brief 	Comprueba si un fichero está abierto a partir de su número de aperturas.
+ * @return 	Devuelve 1 si el fichero recibido por parámetro está abierto, 0 si no lo está.
+ */
+int isOpen(int idFile){
+	if(idFile<0 || idFile>=s_bloque.numInodos){
+		return 0;
+	}
+	return ArrayEstados[idFile].aperturas>0;
+}
+
+/*
+ * @brief 	Comprueba si alguno de los descriptores abiertos sobre un fichero tiene una proyección activa obtenida con mapFile.
+ * @return 	Devuelve 1 si el fichero está proyectado, 0 si no lo está.
+ */
+int isMapped(int idFile){
+	int d;
+	for(d= findDescFile(idFile); d>=0; d= ArrayDescriptores[d].siguiente){
+		if(ArrayDescriptores[d].mapeado){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Devuelve el descriptor asociado a un fichero.
+ * @return 	Primer descriptor abierto sobre el fichero con identificador idFile. -1 en caso de que ese fichero no tenga asociado un descriptor.
+ */
+int findDescFile(int idFile){
+	if(idFile<0 || idFile>=s_bloque.numInodos){
+		return -1;
+	}
+	return ArrayEstados[idFile].primerDesc;
+}
+
+/*
+ * @brief 	Saca un descriptor de la lista de descriptores libres y lo añade a la lista de descriptores abiertos del fichero idFile.
+ */
+void linkDesc(int descriptor, int idFile){
+	if(primerDescLibre==descriptor){
+		primerDescLibre= ArrayDescriptores[descriptor].siguiente;
+	}
+	else{
+		int d= primerDescLibre;
+		while(d>=0 && ArrayDescriptores[d].siguiente!=descriptor){
+			d= ArrayDescriptores[d].siguiente;
+		}
+		if(d>=0){
+			ArrayDescriptores[d].siguiente= ArrayDescriptores[descriptor].siguiente;
+		}
+	}
+	ArrayDescriptores[descriptor].idFichero= idFile;
+	ArrayDescriptores[descriptor].siguiente= ArrayEstados[idFile].primerDesc;
+	ArrayEstados[idFile].primerDesc= descriptor;
+	ArrayEstados[idFile].aperturas++;
+}
+
+/*
+ * @brief 	Saca un descriptor de la lista de descriptores abiertos de su fichero y lo devuelve a la lista de descriptores libres.
+ */
+void unlinkDesc(int descriptor){
+	int idFile= ArrayDescriptores[descriptor].idFichero;
+	if(ArrayEstados[idFile].primerDesc==descriptor){
+		ArrayEstados[idFile].primerDesc= ArrayDescriptores[descriptor].siguiente;
+	}
+	else{
+		int d= ArrayEstados[idFile].primerDesc;
+		while(d>=0 && ArrayDescriptores[d].siguiente!=descriptor){
+			d= ArrayDescriptores[d].siguiente;
+		}
+		if(d>=0){
+			ArrayDescriptores[d].siguiente= ArrayDescriptores[descriptor].siguiente;
+		}
+	}
+	ArrayEstados[idFile].aperturas--;
+	ArrayDescriptores[descriptor].idFichero= -1;	//No se puede inicializar a 0 ya que se utiliza para identificar un fichero.
+	ArrayDescriptores[descriptor].siguiente= primerDescLibre;
+	primerDescLibre= descriptor;
+}
+
+/*
+ * @brief 	Calcula el número de bloque de disco correspondiente al bloque de datos asignado al fichero con identificador idFile
+ * @return 	Número de bloque de datos correspondiente al fichero con identificador idFile, -1 si el fichero no se ha escrito nunca
+ * 		y no tiene bloque asignado.
  */
 int getNumBloque(int idFile){
-	if(!iNodosExtra){
-		return idFile+1;
+	if(ArrayInodos[idFile].sinEscribir){
+		return -1;
+	}
+	return getPrimerBloqueDatos()+ArrayInodos[idFile].bloqueDatos;
+}
+
+/*
+ * @brief 	Calcula el número de bloque de disco en el que empiezan los bloques de datos (después de los bloques de metadatos).
+ * @return 	Número del primer bloque de datos.
+ */
+int getPrimerBloqueDatos(){
+	return bloquesMetadatos;
+}
+
+/*
+ * @brief 	Obtiene el nombre del fichero con identificador idFile. El puntero deja de ser válido si el montón de nombres se compacta.
+ * @return 	Nombre del fichero, guardado en el montón de nombres.
+ */
+char* getFileName(int idFile){
+	return montonNombres+ArrayInodos[idFile].nombre;
+}
+
+/*
+ * @brief 	Calcula la capacidad del montón de nombres: el espacio de los bloques de metadatos que queda tras los Inodos, como mucho
+ * 		MAX_MONTON_NOMBRES bytes para que cualquier posición quepa en el Inodo. Reserva el montón con un byte más a '\0' para
+ * 		que cualquier nombre leído del disco esté terminado.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int initNameHeap(){
+	int inicioMonton= sizeof(s_bloque)+sizeof(mapaInodos)+sizeof(mapaBloques)+sizeof(CRCmetadata)+sizeof(Inodo)*s_bloque.numInodos;
+	tamMontonNombres= bloquesMetadatos*tamBloque-inicioMonton;
+	if(tamMontonNombres>MAX_MONTON_NOMBRES){
+		tamMontonNombres= MAX_MONTON_NOMBRES;
+	}
+	if(tamMontonNombres<=0){
+		return -1;
+	}
+	montonNombres= (char*) calloc(tamMontonNombres+1, 1);
+	return montonNombres==NULL ? -1 : 0;
+}
+
+/*
+ * @brief 	Calcula qué parte del montón de nombres se guarda en el bloque de metadatos numBloque (0 o 1). El montón empieza en el
+ * 		primer bloque tras los Inodos y continúa desde el principio del segundo.
+ * @return 	Número de bytes del montón guardados en el bloque. En inicio se devuelve su posición en el montón y en desplazamiento
+ * 		su posición en el bloque.
+ */
+static int getNameHeapSlice(int numBloque, int* inicio, int* desplazamiento){
+	int inicioMonton= sizeof(s_bloque)+sizeof(mapaInodos)+sizeof(mapaBloques)+sizeof(CRCmetadata)+sizeof(Inodo)*s_bloque.numInodos;
+	int enPrimerBloque= tamBloque-inicioMonton;
+	if(enPrimerBloque>tamMontonNombres){
+		enPrimerBloque= tamMontonNombres;
+	}
+	if(numBloque==0){
+		*inicio= 0;
+		*desplazamiento= inicioMonton;
+		return enPrimerBloque;
+	}
+	*inicio= enPrimerBloque;
+	*desplazamiento= 0;
+	return tamMontonNombres-enPrimerBloque;
+}
+
+/*
+ * @brief 	Copia los Inodos y el montón de nombres guardados en los bloques de metadatos del disco a inodos y monton. r_bloque
+ * 		contiene el bloque 0 ya leído; si hay segundo bloque de metadatos se lee en r_bloque.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int readMetadataBlocks(char* r_bloque, void* inodos, char* monton){
+	int inicio, desplazamiento, longitud;
+	memcpy(inodos, r_bloque+sizeof(s_bloque)+sizeof(mapaInodos)+sizeof(mapaBloques)+sizeof(CRCmetadata), sizeof(Inodo)*s_bloque.numInodos);
+	longitud= getNameHeapSlice(0, &inicio, &desplazamiento);
+	memcpy(monton+inicio, r_bloque+desplazamiento, longitud);
+	if(bloquesMetadatos>1){
+		if(readInodeBlock(1, r_bloque)<0){
+			return -1;
+		}
+		longitud= getNameHeapSlice(1, &inicio, &desplazamiento);
+		memcpy(monton+inicio, r_bloque+desplazamiento, longitud);
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Añade un nombre al final del montón de nombres. Los nombres de los ficheros borrados no se reutilizan: cuando no queda
+ * 		espacio al final se compacta el montón. Se llama con el cerrojo de los Inodos.
+ * @return 	Posición del nombre en el montón, -1 si no cabe.
+ */
+int appendName(char* nombre){
+	int longitud= strlen(nombre)+1;
+	if(s_bloque.finMontonNombres+longitud>tamMontonNombres){
+		compactNameHeap();
+		if(s_bloque.finMontonNombres+longitud>tamMontonNombres){
+			return -1;
+		}
+	}
+	int posicion= s_bloque.finMontonNombres;
+	memcpy(montonNombres+posicion, nombre, longitud);
+	s_bloque.finMontonNombres+= longitud;
+	return posicion;
+}
+
+/*
+ * @brief 	Descarta los nombres añadidos al final del montón de nombres desde la posición indicada, al deshacer creaciones cuyos
+ * 		metadatos no se han podido escribir. Se llama con el cerrojo de los Inodos.
+ */
+void releaseNames(int posicion){
+	if(posicion<s_bloque.finMontonNombres){
+		memset(montonNombres+posicion, 0, s_bloque.finMontonNombres-posicion);
+		s_bloque.finMontonNombres= posicion;
+	}
+}
+
+/*
+ * @brief 	Compacta el montón de nombres sobre sí mismo: recorre los nombres en el orden en que se añadieron, desplaza hacia el
+ * 		principio los de los ficheros existentes, actualizando su posición en los Inodos, y deja a ceros el resto. Se llama con
+ * 		el cerrojo de los Inodos.
+ */
+void compactNameHeap(){
+	int fin= 0;
+	int posicion= 0;
+	while(posicion<s_bloque.finMontonNombres){
+		int longitud= strlen(montonNombres+posicion)+1;
+		int i;
+		for(i=0; i<s_bloque.numInodos; i++){
+			if(mapaInodos[i] && ArrayInodos[i].nombre==posicion){
+				memmove(montonNombres+fin, montonNombres+posicion, longitud);
+				ArrayInodos[i].nombre= fin;
+				fin+= longitud;
+				break;
+			}
+		}
+		posicion+= longitud;
+	}
+	memset(montonNombres+fin, 0, s_bloque.finMontonNombres-fin);
+	s_bloque.finMontonNombres= fin;
+}
+
+/*
+ * @brief 	Compara un nombre con el que empieza en la posición indicada del montón de nombres guardado en los bloques de metadatos
+ * 		del disco, sin copiarlo. El montón empieza en bloque0 tras los Inodos y continúa en bloque1 (NULL si no hay segundo bloque).
+ * @return 	1 si los nombres son iguales, 0 en caso contrario.
+ */
+int compareDiskName(const char* nombre, const char* bloque0, const char* bloque1, int posicion){
+	int inicio, desplazamiento;
+	int enPrimerBloque= getNameHeapSlice(0, &inicio, &desplazamiento);
+	int i;
+	for(i=0; ; i++){
+		char c= '\0';
+		if(posicion+i<enPrimerBloque){
+			c= bloque0[desplazamiento+posicion+i];
+		}
+		else if(bloque1!=NULL && posicion+i<tamMontonNombres){
+			c= bloque1[posicion+i-enPrimerBloque];
+		}
+		if(c!=nombre[i]){
+			return 0;
+		}
+		if(c=='\0'){
+			return 1;
+		}
+	}
+}
+
+/*
+ * @brief 	Vuelve a retirar los bloques del registro liberados por una escritura de los metadatos que ha fallado.
+ */
+static void restoreRetiredBlocks(const char* liberados){
+	int i;
+	for(i=0; i<s_bloque.numBloquesDatos; i++){
+		if(liberados[i]){
+			mapaBloques[i]= 1;
+			bloquesRetirados[i]= 1;
+		}
 	}
-	return idFile+2;
 }
 
 /*
- * @brief 	Escribe los metadatos a disco.
+ * @brief 	Escribe los metadatos a disco y aplica la política de durabilidad.
  * @return 	Si se ejecuta con éxito devuelve 0. Si se produce algún error devuelve -1. 
  */
 int writeMetadata(){
+	unsigned long escritura;
+	if(writeMetadataBlocks(&escritura)<0){
+		return -1;
+	}
+	return commitMetadata(escritura);
+}
 
-	/* Actualiza el valor de CRC de metadatos */
-	updateCRCMetadata();
+/*
+ * @brief 	Escribe los bloques de metadatos a disco, sin aplicar la política de durabilidad. Se puede llamar con el cerrojo de los
+ * 		Inodos tomado; después hay que llamar a commitMetadata sin él. En escritura devuelve el número de esta escritura.
+ * @return 	Si se ejecuta con éxito devuelve 0. Si se produce algún error devuelve -1 y los metadatos en memoria no cambian.
+ */
+int writeMetadataBlocks(unsigned long* escritura){
 
-	/* Escribe a disco los metadatos del primer bloque */
-	char* w_bloque= calloc(1, BLOCK_SIZE);
-	memcpy(w_bloque, &(s_bloque), sizeof(s_bloque));
-	memcpy(w_bloque+sizeof(s_bloque), mapaInodos , sizeof(mapaInodos));
-	memcpy(w_bloque+sizeof(s_bloque)+sizeof(mapaInodos), &CRCmetadata , sizeof(CRCmetadata));
-	memcpy(w_bloque+sizeof(s_bloque)+sizeof(mapaInodos)+ sizeof(CRCmetadata), ArrayInodos , sizeof(Inodo)*iNodosPrimerBloque);
-	if(bwrite(DEVICE_IMAGE, 0, w_bloque)<0){
-		return -1;
+	/* Los bloques de metadatos no se escriben mientras la verificación en segundo plano los está leyendo */
+	pthread_mutex_lock(&mutexInodos);
+
+	/* Los bloques retirados del registro no están referenciados por los metadatos que se van a escribir, por lo que se liberan
+	   con ellos. Ninguna escritura puede reutilizarlos antes, ya que para reservar un bloque hay que tener el cerrojo. */
+	char liberados[MAX_BLOQUES_DATOS];
+	int i;
+	for(i=0; i<s_bloque.numBloquesDatos; i++){
+		liberados[i]= bloquesRetirados[i];
+		if(bloquesRetirados[i]){
+			mapaBloques[i]= 0;
+			bloquesRetirados[i]= 0;
+		}
 	}
-			
-	/* Escribe a disco los metadatos del segundo bloque (si los hay) */
-	if(iNodosExtra>0){
-		memset(w_bloque, 0, BLOCK_SIZE);
-		memcpy(w_bloque, ArrayInodos + sizeof(Inodo)*iNodosPrimerBloque, sizeof(Inodo)*iNodosExtra);
-		if(bwrite(DEVICE_IMAGE, 1, w_bloque)!=0){
+
+	/* Escribe a disco los metadatos del segundo bloque (si lo hay): el final del montón de nombres. Mientras los nombres quepan
+	   en el primer bloque queda por encima de la marca de agua y no se escribe (al formatear sólo se escribe el bloque 0). Se
+	   escribe antes que el primer bloque para que la marca de agua sólo avance cuando el bloque ya está inicializado en disco. */
+	int inicio, desplazamiento;
+	int enPrimerBloque= getNameHeapSlice(0, &inicio, &desplazamiento);
+	if(bloquesMetadatos>1 && (s_bloque.bloquesIniciados>1 || s_bloque.finMontonNombres>enPrimerBloque)){
+		char* w_bloque= getBlockBuffer();
+		if(w_bloque==NULL){
+			restoreRetiredBlocks(liberados);
+			pthread_mutex_unlock(&mutexInodos);
+			return -1;
+		}
+		memset(w_bloque, 0, tamBloque);
+		int longitud= getNameHeapSlice(1, &inicio, &desplazamiento);
+		memcpy(w_bloque+desplazamiento, montonNombres+inicio, longitud);
+		if(writeBlock(1, w_bloque)!=0){
+			releaseBlockBuffer(w_bloque);
+			restoreRetiredBlocks(liberados);
+			pthread_mutex_unlock(&mutexInodos);
 			return -1;
 		}
+		releaseBlockBuffer(w_bloque);
+		s_bloque.bloquesIniciados= 2;
+	}
+
+	/* Escribe a disco los metadatos del primer bloque */
+	if(writeSuperblock()<0){
+		restoreRetiredBlocks(liberados);
+		pthread_mutex_unlock(&mutexInodos);
+		return -1;
 	}
 
-	/* Liberación de la memoria reservada */
-	free(w_bloque);
+	/* Bloques cuyo espacio se puede devolver a la imagen una vez confirmados estos metadatos: los liberados desde la escritura
+	   anterior y los retirados del registro con esta. Se guarda también qué bloques están libres en los metadatos escritos. */
+	for(i=0; i<s_bloque.numBloquesDatos; i++){
+		bloquesPorPerforar[i]|= bloquesPorLiberar[i] || liberados[i];
+		libresEscritos[i]= !mapaBloques[i];
+		bloquesPorLiberar[i]= 0;
+	}
+	*escritura= escriturasMetadatos;
+	pthread_mutex_unlock(&mutexInodos);
+	return 0;
+}
+
+/*
+ * @brief 	Aplica la política de durabilidad a los metadatos escritos con writeMetadataBlocks y devuelve a la imagen el espacio de
+ * 		los bloques que esos metadatos liberan. Se llama sin el cerrojo de los Inodos para que el fsync no detenga a las demás
+ * 		operaciones y varias confirmaciones puedan compartirlo.
+ * @return 	Si se ejecuta con éxito devuelve 0. Si se produce algún error devuelve -1: los metadatos están escritos pero pueden
+ * 		no ser duraderos.
+ */
+int commitMetadata(unsigned long escritura){
+
+	/* Aplicación de la política de durabilidad. Si falla los metadatos pueden no estar en disco y no se perfora ningún hueco. */
+	if(metadataCommitted()<0){
+		return -1;
+	}
 
+	/* Los bloques liberados por los metadatos escritos ya no están referenciados en disco, así que su espacio se devuelve a la
+	   imagen. Los que entretanto se han vuelto a reservar se conservan. Cada hueco cubre los bloques contiguos también libres en
+	   los metadatos escritos. Si otro hilo ha escrito los metadatos después, los que están en disco pueden no ser duraderos
+	   todavía: los bloques se dejan para la confirmación de esa escritura. */
+	pthread_mutex_lock(&mutexInodos);
+	if(escritura!=escriturasMetadatos){
+		pthread_mutex_unlock(&mutexInodos);
+		return 0;
+	}
+	int i;
+	for(i=0; i<s_bloque.numBloquesDatos; i++){
+		if(bloquesPorPerforar[i] && libresEscritos[i] && !mapaBloques[i]){
+			punchBlock(i, libresEscritos);
+			int j;
+			for(j=i; j<s_bloque.numBloquesDatos && libresEscritos[j] && !mapaBloques[j]; j+= numDispositivos){
+				bloquesPorPerforar[j]= 0;
+			}
+		}
+		bloquesPorPerforar[i]= 0;
+	}
+	pthread_mutex_unlock(&mutexInodos);
 	return 0;
 }
 
 /*
- * @brief 	Escribe los metadatos a disco.
+ * @brief 	Actualiza el CRC de los metadatos y escribe a disco el primer bloque de metadatos: superbloque, mapas de Inodos y de bloques, CRC,
+ * 		Inodos y el principio del montón de nombres. La parte del montón del segundo bloque se incluye en el CRC pero no se escribe.
+ * @return 	Si se ejecuta con éxito devuelve 0. Si se produce algún error devuelve -1.
+ */
+int writeSuperblock(){
+	char* w_bloque= getBlockBuffer();
+	if(w_bloque==NULL){
+		return -1;
+	}
+	memset(w_bloque, 0, tamBloque);
+	pthread_mutex_lock(&mutexInodos);
+
+	/* Actualiza el valor de CRC de metadatos */
+	updateCRCMetadata();
+
+	/* Escribe a disco los metadatos del primer bloque */
+	memcpy(w_bloque, &(s_bloque), sizeof(s_bloque));
+	memcpy(w_bloque+sizeof(s_bloque), mapaInodos , sizeof(mapaInodos));
+	memcpy(w_bloque+sizeof(s_bloque)+sizeof(mapaInodos), mapaBloques , sizeof(mapaBloques));
+	memcpy(w_bloque+sizeof(s_bloque)+sizeof(mapaInodos)+sizeof(mapaBloques), &CRCmetadata , sizeof(CRCmetadata));
+	memcpy(w_bloque+sizeof(s_bloque)+sizeof(mapaInodos)+sizeof(mapaBloques)+ sizeof(CRCmetadata), ArrayInodos , sizeof(Inodo)*s_bloque.numInodos);
+	int inicio, desplazamiento;
+	int longitud= getNameHeapSlice(0, &inicio, &desplazamiento);
+	memcpy(w_bloque+desplazamiento, montonNombres+inicio, longitud);
+	int ret= writeBlock(0, w_bloque);
+	escriturasMetadatos++;
+	pthread_mutex_unlock(&mutexInodos);
+
+	/* Liberación del buffer */
+	releaseBlockBuffer(w_bloque);
+	return ret<0 ? -1 : 0;
+}
+
+/*
+ * @brief 	Actualiza el valor del CRC de los metadatos en memoria (superbloque, mapas de Inodos y de bloques, Inodos y la parte ocupada
+ * 		del montón de nombres).
  * @return 	Si se ejecuta con éxito devuelve 0. Si se produce algún error devuelve -1. 
  */
 int updateCRCMetadata(){
-	int numBytesMetadatos= sizeof(s_bloque) + sizeof(mapaInodos) + sizeof(Inodo)*s_bloque.numInodos;
-	unsigned char* b_aux= (unsigned char *) calloc(1, numBytesMetadatos);
+	int numBytesMetadatos= sizeof(s_bloque) + sizeof(mapaInodos) + sizeof(mapaBloques) + sizeof(Inodo)*s_bloque.numInodos + s_bloque.finMontonNombres;
+	unsigned char* b_aux= bufferMetadatos;
 	memcpy(b_aux, &s_bloque, sizeof(s_bloque));
 	memcpy(b_aux + sizeof(s_bloque), mapaInodos, sizeof(mapaInodos));
-	memcpy(b_aux + sizeof(s_bloque) + sizeof(mapaInodos), ArrayInodos, sizeof(Inodo)*s_bloque.numInodos);
+	memcpy(b_aux + sizeof(s_bloque) + sizeof(mapaInodos), mapaBloques, sizeof(mapaBloques));
+	memcpy(b_aux + sizeof(s_bloque) + sizeof(mapaInodos) + sizeof(mapaBloques), ArrayInodos, sizeof(Inodo)*s_bloque.numInodos);
+	memcpy(b_aux + sizeof(s_bloque) + sizeof(mapaInodos) + sizeof(mapaBloques) + sizeof(Inodo)*s_bloque.numInodos, montonNombres, s_bloque.finMontonNombres);
 	CRCmetadata= CRC16(b_aux, numBytesMetadatos);
 	return 0;
 }
+
+/*
+ * @brief 	Comprueba el CRC de numSectores sectores consecutivos del fichero idFile, a partir de primerSector. datos contiene el
+ * 		contenido de esos sectores. Los sectores modificados desde que se calcularon sus CRC no se comprueban.
+ * @return 	0 si los sectores son correctos, -1 si alguno está corrupto.
+ */
+int verifySectors(int idFile, char* datos, int primerSector, int numSectores){
+	int i;
+	for(i=0; i<numSectores; i++){
+		int sector= primerSector+i;
+		if(ArrayEstados[idFile].sectoresModificados & (1u<<sector)){
+			continue;
+		}
+		if(CRC16((unsigned char*)datos+i*tamSector, tamSector)!=ArrayInodos[idFile].CRCsectores[sector]){
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Marca como modificados los sectores del fichero idFile que contienen los numBytes bytes a partir de offset.
+ */
+void markModifiedSectors(int idFile, int offset, int numBytes){
+	int sector;
+	for(sector= offset/tamSector; sector<=(offset+numBytes-1)/tamSector; sector++){
+		ArrayEstados[idFile].sectoresModificados|= 1u<<sector;
+	}
+}
+
+/*
+ * @brief 	Detiene los hilos del montaje y libera todas las variables del sistema de ficheros. Se utiliza al desmontar y cuando
+ * 		el montaje falla a medias, por lo que admite que parte del estado no se haya llegado a reservar.
+ */
+void releaseMountState(){
+	destroyCleaner();
+	destroyScrubber();
+	destroyDurability();
+	destroyReadahead();
+	unmapDeviceImage();
+	destroyNameIndex();
+	closeDirectDevice();
+	destroyBufferPool();
+	free(ArrayInodos);
+	free(montonNombres);
+	free(ArrayDescriptores);
+	free(ArrayEstados);
+	ArrayInodos= NULL;
+	montonNombres= NULL;
+	ArrayDescriptores= NULL;
+	numDescriptores= 0;
+	ArrayEstados= NULL;
+	bloquesMetadatos=0;
+	tamMontonNombres=0;
+	tamBloque=0;
+	tamSector=0;
+	CRCmetadata=0;
+	memset(mapaInodos, 0, sizeof(mapaInodos));
+	memset(mapaBloques, 0, sizeof(mapaBloques));
+	memset(bloquesRetirados, 0, sizeof(bloquesRetirados));
+	memset(bloquesPorLiberar, 0, sizeof(bloquesPorLiberar));
+	memset(bloquesPorPerforar, 0, sizeof(bloquesPorPerforar));
+	memset(&s_bloque, 0, sizeof(s_bloque));
+}
+
+/*
+ * @brief 	Comprueba el CRC de los metadatos guardados en disco. Se excluye de las escrituras de metadatos para no leer bloques
+ * 		a medio escribir.
+ * @return 	0 si los metadatos son correctos, -1 si están corruptos, -2 si se produce algún error.
+ */
+int verifyMetadata(){
+	pthread_mutex_lock(&mutexInodos);
+	/* Lectura del primer bloque de disco para obtener los metadatos */
+	char* r_bloque= getBlockBuffer();
+	if(r_bloque==NULL){
+		pthread_mutex_unlock(&mutexInodos);
+		return -2;
+	}
+	if(readBlock(0 , r_bloque)<0){
+		releaseBlockBuffer(r_bloque);
+		pthread_mutex_unlock(&mutexInodos);
+		return -2;
+	}
+
+	/* Obtención del valor de CRCMetadata guardado en el disco */
+	uint16_t crcDisco;
+	memcpy(&crcDisco, r_bloque + sizeof(s_bloque) + sizeof(mapaInodos) + sizeof(mapaBloques) , sizeof(crcDisco));
+	
+	/* Copia de los metadatos guardados en disco a un buffer auxiliar. Puesto que el CRC se encuentra entre los mapas y los Inodos
+	   se tiene que copiar el contenido por partes para no copiar al buffer el CRC de los metadatos. Del montón de nombres sólo se
+	   comprueba la parte ocupada según el superbloque del disco. */
+	SuperBloque superbloqueDisco;
+	memcpy(&superbloqueDisco, r_bloque, sizeof(superbloqueDisco));
+	int numBytesCabecera= sizeof(s_bloque) + sizeof(mapaInodos) + sizeof(mapaBloques);
+	unsigned char* b_aux= bufferMetadatos;
+	memcpy(b_aux, r_bloque, numBytesCabecera);
+	if(superbloqueDisco.finMontonNombres>tamMontonNombres || readMetadataBlocks(r_bloque, b_aux+numBytesCabecera, (char*) b_aux+numBytesCabecera+sizeof(Inodo)*s_bloque.numInodos)<0){
+		releaseBlockBuffer(r_bloque);
+		pthread_mutex_unlock(&mutexInodos);
+		return superbloqueDisco.finMontonNombres>tamMontonNombres ? -1 : -2;
+	}
+	int numBytesMetadatos= numBytesCabecera + sizeof(Inodo)*s_bloque.numInodos + superbloqueDisco.finMontonNombres;
+
+	/* Aplicación de la función CRC a los metadatos obtenidos del disco */
+	uint16_t crcMetadatos = CRC16(b_aux, numBytesMetadatos);
+
+	/* Liberación del buffer */
+	releaseBlockBuffer(r_bloque);
+	pthread_mutex_unlock(&mutexInodos);
+
+	/* Comparación entre el CRC obtenido del disco y el CRC calculado a partir de los metadatos de disco */
+	if(crcDisco==crcMetadatos){
+		return 0;
+	}
+
+	/* Si llega a este punto los metadatos están corruptos, devuelve error. */
+	return -1;
+}
+
+/*
+ * @brief 	Espera el tiempo correspondiente a la lectura de numBloques bloques al ritmo de la verificación en segundo plano.
+ * 		La espera se interrumpe al detener la verificación.
+ */
+static void throttleScrubber(int numBloques){
+	long espera= (long) numBloques*1000000000L/bloquesPorSegundo;	// En nanosegundos
+	struct timespec limite;
+	clock_gettime(CLOCK_REALTIME, &limite);
+	limite.tv_sec+= espera/1000000000L;
+	limite.tv_nsec+= espera%1000000000L;
+	if(limite.tv_nsec>=1000000000L){
+		limite.tv_sec++;
+		limite.tv_nsec-= 1000000000L;
+	}
+	pthread_mutex_lock(&mutexVerificacion);
+	if(verificacionActiva){
+		pthread_cond_timedwait(&condVerificacion, &mutexVerificacion, &limite);
+	}
+	pthread_mutex_unlock(&mutexVerificacion);
+}
+
+/*
+ * @brief 	Comprueba el bloque de datos del fichero idFile contra los CRC de sus sectores. Sólo se comprueban los ficheros cerrados,
+ * 		escritos y que no están ya en cuarentena: los CRC de un fichero abierto no están actualizados hasta cerrarlo.
+ * @return 	0 si el fichero es correcto, 1 si está corrupto (y en nombre se copia su nombre), 2 si no se ha comprobado y -1 si se
+ * 		produce algún error.
+ */
+static int scrubFile(int idFile, char* nombre){
+	pthread_mutex_lock(&mutexInodos);
+	if(!mapaInodos[idFile] || ArrayEstados[idFile].aperturas>0 || ArrayEstados[idFile].cuarentena || ArrayInodos[idFile].sinEscribir){
+		pthread_mutex_unlock(&mutexInodos);
+		return 2;
+	}
+
+	/* Lectura del bloque directamente del disco, sin pasar por la caché de lectura, para comprobar lo que hay realmente guardado */
+	char* r_bloque= getBlockBuffer();
+	if(r_bloque==NULL || readBlock(getNumBloque(idFile), r_bloque)<0){
+		releaseBlockBuffer(r_bloque);
+		pthread_mutex_unlock(&mutexInodos);
+		return -1;
+	}
+	int corrupto= 0;
+	int i;
+	for(i=0; i<NUM_SECTORES_CRC; i++){
+		if(ArrayInodos[idFile].CRCsectores[i]!=CRC16((unsigned char*)r_bloque+i*tamSector, tamSector)){
+			corrupto= 1;
+		}
+	}
+	releaseBlockBuffer(r_bloque);
+
+	/* Un fichero corrupto se pone en cuarentena (si se ha pedido) para que no se pueda abrir hasta que se reemplace o se borre */
+	if(corrupto){
+		strcpy(nombre, getFileName(idFile));
+		if(aislarCorruptos){
+			ArrayEstados[idFile].cuarentena= 1;
+		}
+	}
+	pthread_mutex_unlock(&mutexInodos);
+	return corrupto;
+}
+
+/*
+ * @brief 	Consulta, con el cerrojo de la verificación, si el hilo de verificación debe seguir en ejecución.
+ * @return 	1 si la verificación está activa, 0 si se ha pedido que se detenga.
+ */
+static int isScrubberActive(){
+	pthread_mutex_lock(&mutexVerificacion);
+	int activa= verificacionActiva;
+	pthread_mutex_unlock(&mutexVerificacion);
+	return activa;
+}
+
+/*
+ * @brief 	Hilo de verificación en segundo plano. En cada pasada comprueba el CRC de los metadatos y después el de los bloques de
+ * 		datos de todos los ficheros, leyendo como mucho bloquesPorSegundo bloques por segundo. Se ejecuta con prioridad de CPU
+ * 		y de E/S ociosa para no competir con las operaciones del programa.
+ */
+static void* scrubWorker(void* arg){
+	(void) arg;
+	/* Prioridad ociosa (SCHED_IDLE y clase de E/S IOPRIO_CLASS_IDLE). Si el sistema no la permite se continúa con la normal. */
+	struct sched_param parametros= {0};
+	pthread_setschedparam(pthread_self(), SCHED_IDLE, &parametros);
+	syscall(SYS_ioprio_set, 1, (int) syscall(SYS_gettid), 3<<13);	// IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE
+
+	char nombre[MAX_LONGITUD_NOMBRE+1];
+	while(isScrubberActive()){
+
+		/* Comprobación de los metadatos */
+		if(verifyMetadata()==-1){
+			pthread_mutex_lock(&mutexVerificacion);
+			estadisticasVerificacion.metadataErrors++;
+			pthread_mutex_unlock(&mutexVerificacion);
+			if(informarCorrupcion!=NULL){
+				informarCorrupcion(NULL, argumentoInforme);
+			}
+		}
+		throttleScrubber(bloquesMetadatos);
+
+		/* Comprobación de los bloques de datos de los ficheros */
+		int i;
+		for(i=0; i<s_bloque.numInodos && isScrubberActive(); i++){
+			int ret= scrubFile(i, nombre);
+			if(ret==1){
+				pthread_mutex_lock(&mutexVerificacion);
+				estadisticasVerificacion.corruptFiles++;
+				pthread_mutex_unlock(&mutexVerificacion);
+				if(informarCorrupcion!=NULL){
+					informarCorrupcion(nombre, argumentoInforme);
+				}
+			}
+			if(ret==0 || ret==1){
+				pthread_mutex_lock(&mutexVerificacion);
+				estadisticasVerificacion.blocksVerified++;
+				pthread_mutex_unlock(&mutexVerificacion);
+				throttleScrubber(1);
+			}
+		}
+		pthread_mutex_lock(&mutexVerificacion);
+		if(verificacionActiva){
+			estadisticasVerificacion.passes++;
+		}
+		pthread_mutex_unlock(&mutexVerificacion);
+	}
+	return NULL;
+}
+
+/*
+ * @brief 	Arranca el hilo de verificación en segundo plano con los parámetros de las opciones de montaje.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int initScrubber(const FSMountOptions *options){
+	bloquesPorSegundo= options->scrubRate;
+	aislarCorruptos= options->scrubQuarantine;
+	informarCorrupcion= options->scrubReport;
+	argumentoInforme= options->scrubReportArg;
+	memset(&estadisticasVerificacion, 0, sizeof(estadisticasVerificacion));
+
+	verificacionActiva= 1;
+	if(pthread_create(&hiloVerificacion, NULL, scrubWorker, NULL)!=0){
+		verificacionActiva= 0;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Detiene el hilo de verificación en segundo plano (si está en ejecución) y espera a que termine.
+ */
+void destroyScrubber(){
+	if(verificacionActiva){
+		pthread_mutex_lock(&mutexVerificacion);
+		verificacionActiva= 0;
+		pthread_cond_signal(&condVerificacion);
+		pthread_mutex_unlock(&mutexVerificacion);
+		pthread_join(hiloVerificacion, NULL);
+	}
+}
+
+/*
+ * @brief 	Comprueba si un segmento del registro está libre: ninguno de sus bloques está ocupado ni retirado.
+ * @return 	1 si el segmento está libre, 0 en caso contrario.
+ */
+static int isCleanSegment(int segmento){
+	int i;
+	for(i=segmento*TAM_SEGMENTO; i<(segmento+1)*TAM_SEGMENTO && i<s_bloque.numBloquesDatos; i++){
+		if(mapaBloques[i]){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * @brief 	Cuenta los segmentos libres del registro.
+ * @return 	Número de segmentos libres.
+ */
+static int countCleanSegments(){
+	int numSegmentos= (s_bloque.numBloquesDatos+TAM_SEGMENTO-1)/TAM_SEGMENTO;
+	int libres= 0;
+	int i;
+	for(i=0; i<numSegmentos; i++){
+		libres+= isCleanSegment(i);
+	}
+	return libres;
+}
+
+/*
+ * @brief 	Reserva el siguiente bloque libre de la cabeza del registro y avanza la cabeza. Al empezar un segmento la cabeza salta
+ * 		al siguiente segmento libre para que las escrituras sean secuenciales; si no queda ninguno se continúa por el siguiente
+ * 		bloque libre. Los bloques del segmento segmentoExcluido (el que está compactando el limpiador) no se reservan. Se ha de
+ * 		llamar con el cerrojo de los Inodos.
+ * @return 	Bloque reservado (relativo al primer bloque de datos), -1 si no hay ninguno libre.
+ */
+int appendLogBlock(int segmentoExcluido){
+	int numBloques= s_bloque.numBloquesDatos;
+	int numSegmentos= (numBloques+TAM_SEGMENTO-1)/TAM_SEGMENTO;
+	int cabeza= s_bloque.cabezaRegistro%numBloques;
+	int i;
+	if(cabeza%TAM_SEGMENTO==0){
+		for(i=0; i<numSegmentos; i++){
+			int segmento= (cabeza/TAM_SEGMENTO+i)%numSegmentos;
+			if(segmento!=segmentoExcluido && isCleanSegment(segmento)){
+				cabeza= segmento*TAM_SEGMENTO;
+				break;
+			}
+		}
+	}
+	for(i=0; i<numBloques; i++){
+		int bloque= (cabeza+i)%numBloques;
+		if(!mapaBloques[bloque] && bloque/TAM_SEGMENTO!=segmentoExcluido){
+			mapaBloques[bloque]= 1;
+			s_bloque.cabezaRegistro= (bloque+1)%numBloques;
+
+			/* Si quedan pocos segmentos libres se despierta al limpiador */
+			if(countCleanSegments()<SEGMENTOS_LIMPIOS_MIN){
+				pthread_mutex_lock(&mutexLimpiador);
+				if(limpiadorActivo){
+					pthread_cond_signal(&condLimpiador);
+				}
+				pthread_mutex_unlock(&mutexLimpiador);
+			}
+			return bloque;
+		}
+	}
+	return -1;
+}
+
+/*
+ * @brief 	Retira un bloque cuyo contenido se ha vuelto a escribir en la cabeza del registro. Los metadatos en disco aún lo
+ * 		referencian, por lo que sigue ocupado hasta la siguiente escritura de los metadatos. Se ha de llamar con el cerrojo de
+ * 		los Inodos.
+ */
+void retireLogBlock(int bloque){
+	bloquesRetirados[bloque]= 1;
+}
+
+/*
+ * @brief 	Consulta, con el cerrojo del limpiador, si el hilo limpiador del registro debe seguir en ejecución.
+ * @return 	1 si el limpiador está activo, 0 si se ha pedido que se detenga (o no está en ejecución).
+ */
+static int isCleanerActive(){
+	pthread_mutex_lock(&mutexLimpiador);
+	int activo= limpiadorActivo;
+	pthread_mutex_unlock(&mutexLimpiador);
+	return activo;
+}
+
+/*
+ * @brief 	Mueve el bloque de datos bloque a la cabeza del registro, fuera del segmento que se está compactando, y cambia el
+ * 		fichero al que pertenece al nuevo bloque. Los bloques de ficheros abiertos o en cuarentena no se mueven.
+ * @return 	1 si el bloque se ha movido, 0 si no se ha movido, -1 si se produce algún error.
+ */
+static int moveLogBlock(int bloque, int segmento){
+	pthread_mutex_lock(&mutexInodos);
+	if(!mapaBloques[bloque]){
+		pthread_mutex_unlock(&mutexInodos);
+		return 0;
+	}
+	int idFile;
+	for(idFile=0; idFile<s_bloque.numInodos; idFile++){
+		if(mapaInodos[idFile] && !ArrayInodos[idFile].sinEscribir && ArrayInodos[idFile].bloqueDatos==bloque){
+			break;
+		}
+	}
+	if(idFile==s_bloque.numInodos || ArrayEstados[idFile].aperturas>0 || ArrayEstados[idFile].cuarentena){
+		pthread_mutex_unlock(&mutexInodos);
+		return 0;
+	}
+
+	/* Copia del contenido al nuevo bloque. El contenido no cambia, por lo que el CRC de sus sectores sigue siendo válido. */
+	char* b_aux= getBlockBuffer();
+	if(b_aux==NULL || readBlock(getNumBloque(idFile), b_aux)<0){
+		releaseBlockBuffer(b_aux);
+		pthread_mutex_unlock(&mutexInodos);
+		return -1;
+	}
+	int bloqueNuevo= appendLogBlock(segmento);
+	if(bloqueNuevo<0){
+		releaseBlockBuffer(b_aux);
+		pthread_mutex_unlock(&mutexInodos);
+		return -1;
+	}
+	if(writeBlock(getPrimerBloqueDatos()+bloqueNuevo, b_aux)<0){
+		mapaBloques[bloqueNuevo]= 0;
+		releaseBlockBuffer(b_aux);
+		pthread_mutex_unlock(&mutexInodos);
+		return -1;
+	}
+	updateCachedBlock(getPrimerBloqueDatos()+bloqueNuevo, b_aux);
+	releaseBlockBuffer(b_aux);
+
+	retireLogBlock(bloque);
+	ArrayInodos[idFile].bloqueDatos= bloqueNuevo;
+	pthread_mutex_unlock(&mutexInodos);
+	return 1;
+}
+
+/*
+ * @brief 	Compacta el registro si quedan menos de SEGMENTOS_LIMPIOS_MIN segmentos libres. Primero escribe los metadatos para
+ * 		liberar los bloques retirados; si no basta, mueve a la cabeza del registro los bloques vivos del segmento con menos
+ * 		bloques vivos (sin contar el de la cabeza) y vuelve a escribir los metadatos para liberarlo.
+ * @return 	Número de bloques movidos, -1 si se produce algún error.
+ */
+int cleanLog(){
+	pthread_mutex_lock(&mutexInodos);
+	int numBloques= s_bloque.numBloquesDatos;
+	int numSegmentos= (numBloques+TAM_SEGMENTO-1)/TAM_SEGMENTO;
+	if(countCleanSegments()>=SEGMENTOS_LIMPIOS_MIN){
+		pthread_mutex_unlock(&mutexInodos);
+		return 0;
+	}
+
+	/* Liberación de los bloques retirados */
+	int i;
+	int retirados= 0;
+	for(i=0; i<numBloques; i++){
+		retirados+= bloquesRetirados[i];
+	}
+	if(retirados>0){
+
+		/* La escritura de los metadatos toma el cerrojo por sí misma. Se llama sin él para que el fsync de la política de
+		   durabilidad no detenga a las operaciones del programa. */
+		pthread_mutex_unlock(&mutexInodos);
+		if(writeMetadata()<0){
+			return -1;
+		}
+		pthread_mutex_lock(&mutexInodos);
+		if(countCleanSegments()>=SEGMENTOS_LIMPIOS_MIN){
+			pthread_mutex_unlock(&mutexInodos);
+			return 0;
+		}
+	}
+
+	/* Elección del segmento a compactar: el que tiene menos bloques vivos, siempre que quepan en los bloques libres del resto */
+	int libres= 0;
+	for(i=0; i<numBloques; i++){
+		libres+= !mapaBloques[i];
+	}
+	int segmentoCabeza= ((s_bloque.cabezaRegistro+numBloques-1)%numBloques)/TAM_SEGMENTO;
+	int victima= -1;
+	int vivosVictima= TAM_SEGMENTO;
+	int segmento;
+	for(segmento=0; segmento<numSegmentos; segmento++){
+		int vivos= 0;
+		int tamSegmento= 0;
+		int libresSegmento= 0;
+		for(i=segmento*TAM_SEGMENTO; i<(segmento+1)*TAM_SEGMENTO && i<numBloques; i++){
+			vivos+= mapaBloques[i];
+			libresSegmento+= !mapaBloques[i];
+			tamSegmento++;
+		}
+		if(segmento!=segmentoCabeza && vivos>0 && vivos<tamSegmento && vivos<vivosVictima && vivos<=libres-libresSegmento){
+			victima= segmento;
+			vivosVictima= vivos;
+		}
+	}
+	pthread_mutex_unlock(&mutexInodos);
+	if(victima<0){
+		return 0;
+	}
+
+	/* Traslado de los bloques vivos del segmento */
+	int movidos= 0;
+	for(i=victima*TAM_SEGMENTO; i<(victima+1)*TAM_SEGMENTO && i<numBloques && isCleanerActive(); i++){
+		int ret= moveLogBlock(i, victima);
+		if(ret<0){
+			return -1;
+		}
+		movidos+= ret;
+	}
+	if(movidos==0){
+		return 0;
+	}
+
+	/* Con la política FS_DURABILITY_ON_COMMIT los bloques movidos tienen que estar en disco antes que los metadatos que apuntan a ellos */
+	if(politicaDurabilidad==FS_DURABILITY_ON_COMMIT && syncDevice()<0){
+		return -1;
+	}
+	if(writeMetadata()<0){
+		return -1;
+	}
+	return movidos;
+}
+
+/*
+ * @brief 	Hilo limpiador del registro. Comprueba cada INTERVALO_LIMPIADOR milisegundos (o cuando una escritura lo despierta)
+ * 		si quedan pocos segmentos libres y, en ese caso, compacta segmentos. Se ejecuta con prioridad ociosa, igual que la
+ * 		verificación en segundo plano.
+ */
+static void* cleanerWorker(void* arg){
+	(void) arg;
+	struct sched_param parametros= {0};
+	pthread_setschedparam(pthread_self(), SCHED_IDLE, &parametros);
+	syscall(SYS_ioprio_set, 1, (int) syscall(SYS_gettid), 3<<13);	// IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE
+
+	pthread_mutex_lock(&mutexLimpiador);
+	while(limpiadorActivo){
+		struct timespec limite;
+		clock_gettime(CLOCK_REALTIME, &limite);
+		limite.tv_nsec+= (long) INTERVALO_LIMPIADOR*1000000;
+		limite.tv_sec+= limite.tv_nsec/1000000000;
+		limite.tv_nsec%= 1000000000;
+		pthread_cond_timedwait(&condLimpiador, &mutexLimpiador, &limite);
+		if(!limpiadorActivo){
+			break;
+		}
+		pthread_mutex_unlock(&mutexLimpiador);
+		cleanLog();
+		pthread_mutex_lock(&mutexLimpiador);
+	}
+	pthread_mutex_unlock(&mutexLimpiador);
+	return NULL;
+}
+
+/*
+ * @brief 	Arranca el hilo limpiador del registro.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int initCleaner(){
+	limpiadorActivo= 1;
+	if(pthread_create(&hiloLimpiador, NULL, cleanerWorker, NULL)!=0){
+		limpiadorActivo= 0;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Detiene el hilo limpiador del registro (si está en ejecución) y espera a que termine.
+ */
+void destroyCleaner(){
+	if(limpiadorActivo){
+		pthread_mutex_lock(&mutexLimpiador);
+		limpiadorActivo= 0;
+		pthread_cond_signal(&condLimpiador);
+		pthread_mutex_unlock(&mutexLimpiador);
+		pthread_join(hiloLimpiador, NULL);
+	}
+}
+
+/*
+ * @brief 	Fija las imágenes sobre las que trabaja el sistema de ficheros. Los nombres se copian. Con nombres NULL se usa DEVICE_IMAGE.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error (número de imágenes no válido).
+ */
+int setDevices(const char** nombres, int num){
+	if(nombres!=NULL && (num<1 || num>MAX_DISPOSITIVOS)){
+		return -1;
+	}
+	int i;
+	if(nombresPropios){
+		for(i=0; i<numDispositivos; i++){
+			free(dispositivos[i]);
+		}
+		nombresPropios= 0;
+	}
+	if(nombres==NULL){
+		dispositivos[0]= DEVICE_IMAGE;
+		numDispositivos= 1;
+		return 0;
+	}
+	for(i=0; i<num; i++){
+		dispositivos[i]= strdup(nombres[i]);
+	}
+	numDispositivos= num;
+	nombresPropios= 1;
+	return 0;
+}
+
+/*
+ * @brief 	Traduce un bloque del sistema de ficheros a la imagen que lo contiene. Los bloques de metadatos están en la imagen 0 y
+ * 		los bloques de datos se reparten por turnos entre las imágenes: el bloque de datos d está en la imagen d%numDispositivos,
+ * 		en la posición d/numDispositivos a continuación de los bloques de metadatos (que todas las imágenes reservan).
+ * @return 	Índice de la imagen. En bloqueDispositivo se guarda el número de bloque dentro de ella.
+ */
+int locateBlock(int numBloque, int* bloqueDispositivo){
+	int primerBloqueDatos= getPrimerBloqueDatos();
+	if(numDispositivos==1 || numBloque<primerBloqueDatos){
+		*bloqueDispositivo= numBloque;
+		return 0;
+	}
+	int bloqueDatos= numBloque-primerBloqueDatos;
+	*bloqueDispositivo= primerBloqueDatos+bloqueDatos/numDispositivos;
+	return bloqueDatos%numDispositivos;
+}
+
+/*
+ * @brief 	Abre todas las imágenes con los flags indicados y guarda sus descriptores en fds. Si alguna falla cierra las ya abiertas.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+static int openDevices(int* fds, int flags){
+	int i;
+	for(i=0; i<numDispositivos; i++){
+		fds[i]= open(dispositivos[i], flags);
+		if(fds[i]<0){
+			while(--i>=0){
+				close(fds[i]);
+			}
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Cierra los descriptores de las imágenes abiertos con openDevices.
+ */
+static void closeDevices(int* fds){
+	int i;
+	for(i=0; i<numDispositivos; i++){
+		close(fds[i]);
+		fds[i]= -1;
+	}
+}
+
+/*
+ * @brief 	Devuelve a la imagen el espacio del bloque de datos indicado (relativo al primer bloque de datos) perforando un hueco
+ * 		(FALLOC_FL_PUNCH_HOLE) en su posición. El hueco se extiende a los bloques contiguos de la misma imagen que están libres
+ * 		tanto en memoria como en libres (los metadatos confirmados en disco): si el bloque de la imagen es mayor que el del
+ * 		sistema de ficheros, sólo se libera cuando el hueco lo cubre entero. El tamaño de la imagen no cambia y el hueco se lee
+ * 		a ceros. Si el sistema de ficheros de la imagen no lo admite no se modifica. Se ha de llamar con el cerrojo de los Inodos.
+ * @return 	0 si se ejecuta con éxito, -1 si no se ha liberado el espacio.
+ */
+int punchBlock(int bloque, const char* libres){
+	if(!sincronizacionAbierta){
+		return -1;
+	}
+	int primero= bloque;
+	int ultimo= bloque;
+	while(primero-numDispositivos>=0 && libres[primero-numDispositivos] && !mapaBloques[primero-numDispositivos]){
+		primero-= numDispositivos;
+	}
+	while(ultimo+numDispositivos<s_bloque.numBloquesDatos && libres[ultimo+numDispositivos] && !mapaBloques[ultimo+numDispositivos]){
+		ultimo+= numDispositivos;
+	}
+	int bloquePrimero, bloqueUltimo;
+	int dispositivo= locateBlock(getPrimerBloqueDatos()+primero, &bloquePrimero);
+	locateBlock(getPrimerBloqueDatos()+ultimo, &bloqueUltimo);
+	if(fallocate(fdSincronizacion[dispositivo], FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t) bloquePrimero*tamBloque, (off_t) (bloqueUltimo-bloquePrimero+1)*tamBloque)<0){
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Perfora en todas las imágenes un hueco desde el bloque primerBloque hasta el bloque ultimoBloque (sin incluirlo), para
+ * 		que la zona de datos de un sistema de ficheros recién formateado no ocupe espacio hasta que se escribe.
+ * @return 	0 si se ejecuta con éxito, -1 si no se ha liberado el espacio.
+ */
+int punchImages(int primerBloque, int ultimoBloque){
+	int fds[MAX_DISPOSITIVOS];
+	if(ultimoBloque<=primerBloque || openDevices(fds, O_RDWR)<0){
+		return -1;
+	}
+	int resultado= 0;
+	int i;
+	for(i=0; i<numDispositivos; i++){
+		if(fallocate(fds[i], FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t) primerBloque*tamBloque, (off_t) (ultimoBloque-primerBloque)*tamBloque)<0){
+			resultado= -1;
+		}
+	}
+	closeDevices(fds);
+	return resultado;
+}
+
+/*
+ * @brief 	Recalcula el CRC de los sectores del fichero idFile escritos desde la última vez que se calcularon y escribe los metadatos.
+ * 		Sólo se leen y se recalculan los sectores escritos.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int commitModifiedSectors(int idFile){
+	/* Con la política FS_DURABILITY_ON_COMMIT los sectores escritos tienen que estar en disco antes que los metadatos con sus CRC.
+	   El fsync se hace antes de tomar el cerrojo de los Inodos para no detener a las demás operaciones. */
+	if(politicaDurabilidad==FS_DURABILITY_ON_COMMIT && syncDevice()<0){
+		return -1;
+	}
+
+	int numBloque= getNumBloque(idFile);
+	char* r_sector= getBlockBuffer();
+	if(r_sector==NULL){
+		return -1;
+	}
+
+	/* Los CRC se actualizan con el cerrojo de los Inodos para que el limpiador del registro no escriba los metadatos a medias */
+	pthread_mutex_lock(&mutexInodos);
+	int i;
+	for(i=0; i<NUM_SECTORES_CRC; i++){
+		if(ArrayEstados[idFile].sectoresModificados & (1u<<i)){
+			if(readDataBlock(numBloque, i*tamSector, r_sector, tamSector)!=0){
+				releaseBlockBuffer(r_sector);
+				pthread_mutex_unlock(&mutexInodos);
+				return -1;
+			}
+			ArrayInodos[idFile].CRCsectores[i]= CRC16((unsigned char*)r_sector, tamSector);
+		}
+	}
+	releaseBlockBuffer(r_sector);
+	unsigned long escritura;
+	if(writeMetadataBlocks(&escritura)!=0){
+		pthread_mutex_unlock(&mutexInodos);
+		return -1;
+	}
+	ArrayEstados[idFile].sectoresModificados=0;
+	pthread_mutex_unlock(&mutexInodos);
+
+	/* Aplicación de la política de durabilidad sin el cerrojo, para que el fsync no detenga a las demás operaciones */
+	return commitMetadata(escritura);
+}
+
+/*
+ * @brief 	Hilo de sincronización periódica de la política FS_DURABILITY_GROUP. Cada intervaloSincronizacion milisegundos lleva a disco,
+ * 		con un único fsync, todos los metadatos escritos desde la sincronización anterior. Al detenerse sincroniza lo pendiente.
+ */
+static void* syncWorker(void* arg){
+	(void) arg;
+	pthread_mutex_lock(&mutexSync);
+	while(sincronizacionActiva){
+		struct timespec limite;
+		clock_gettime(CLOCK_REALTIME, &limite);
+		limite.tv_sec+= intervaloSincronizacion/1000;
+		limite.tv_nsec+= (long) (intervaloSincronizacion%1000)*1000000L;
+		if(limite.tv_nsec>=1000000000L){
+			limite.tv_sec++;
+			limite.tv_nsec-= 1000000000L;
+		}
+		pthread_cond_timedwait(&condTemporizador, &mutexSync, &limite);
+		if(cambiosPendientes){
+			cambiosPendientes= 0;
+			pthread_mutex_unlock(&mutexSync);
+			if(syncDevice()!=0){
+				pthread_mutex_lock(&mutexSync);
+				cambiosPendientes= 1;	// Se reintenta en la siguiente vuelta
+				continue;
+			}
+			pthread_mutex_lock(&mutexSync);
+		}
+	}
+	pthread_mutex_unlock(&mutexSync);
+	return NULL;
+}
+
+/*
+ * @brief 	Abre el dispositivo para hacer fsync y, con la política FS_DURABILITY_GROUP, arranca el hilo de sincronización periódica.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int initDurability(int politica, int intervaloMs){
+	if(politica<FS_DURABILITY_NONE || politica>FS_DURABILITY_GROUP || intervaloMs<0){
+		return -1;
+	}
+	politicaDurabilidad= politica;
+	intervaloSincronizacion= intervaloMs>0 ? intervaloMs : 5;
+	syncPedidos= 0;
+	syncCompletados= 0;
+	syncEnCurso= 0;
+	cambiosPendientes= 0;
+
+	if(openDevices(fdSincronizacion, O_RDWR)<0){
+		return -1;
+	}
+	sincronizacionAbierta= 1;
+
+	if(politica==FS_DURABILITY_GROUP){
+		sincronizacionActiva= 1;
+		if(pthread_create(&hiloSincronizacion, NULL, syncWorker, NULL)!=0){
+			sincronizacionActiva= 0;
+			destroyDurability();
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Detiene el hilo de sincronización periódica, que sincroniza lo pendiente antes de terminar, y cierra el dispositivo.
+ */
+void destroyDurability(){
+	if(sincronizacionActiva){
+		pthread_mutex_lock(&mutexSync);
+		sincronizacionActiva= 0;
+		cambiosPendientes= 1;
+		pthread_cond_signal(&condTemporizador);
+		pthread_mutex_unlock(&mutexSync);
+		pthread_join(hiloSincronizacion, NULL);
+	}
+	if(sincronizacionAbierta){
+		closeDevices(fdSincronizacion);
+		sincronizacionAbierta= 0;
+	}
+	politicaDurabilidad= FS_DURABILITY_NONE;
+}
+
+/*
+ * @brief 	Hace fsync del dispositivo. Cada llamada toma un turno; el primer hilo que encuentra libre el dispositivo hace un único fsync
+ * 		en nombre de todos los turnos pedidos hasta ese momento, y el resto espera a que su turno quede cubierto por algún fsync
+ * 		(group commit). Así las confirmaciones concurrentes pagan un fsync por lote y no uno por llamada.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int syncDevice(){
+	if(!sincronizacionAbierta){
+		return -1;
+	}
+	pthread_mutex_lock(&mutexSync);
+	unsigned long turno= ++syncPedidos;
+	while(syncCompletados<turno){
+		if(syncEnCurso){
+			pthread_cond_wait(&condSync, &mutexSync);
+			continue;
+		}
+
+		/* Este hilo hace el fsync del lote formado por todos los turnos pedidos hasta ahora: sus escrituras ya se han hecho */
+		syncEnCurso= 1;
+		unsigned long lote= syncPedidos;
+		pthread_mutex_unlock(&mutexSync);
+		int resultado= 0;
+		int i;
+		for(i=0; i<numDispositivos; i++){
+			if(fsync(fdSincronizacion[i])!=0){
+				resultado= -1;
+			}
+		}
+		pthread_mutex_lock(&mutexSync);
+		syncEnCurso= 0;
+		if(resultado==0 && lote>syncCompletados){
+			syncCompletados= lote;
+		}
+		pthread_cond_broadcast(&condSync);
+		if(resultado!=0){
+			pthread_mutex_unlock(&mutexSync);
+			return -1;
+		}
+	}
+	pthread_mutex_unlock(&mutexSync);
+	return 0;
+}
+
+/*
+ * @brief 	Aplica la política de durabilidad del montaje después de escribir los metadatos: con FS_DURABILITY_ON_COMMIT se hace fsync antes
+ * 		de volver y con FS_DURABILITY_GROUP se deja pendiente para el hilo de sincronización periódica.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int metadataCommitted(){
+	if(politicaDurabilidad==FS_DURABILITY_ON_COMMIT){
+		return syncDevice();
+	}
+	if(politicaDurabilidad==FS_DURABILITY_GROUP){
+		pthread_mutex_lock(&mutexSync);
+		cambiosPendientes= 1;
+		pthread_mutex_unlock(&mutexSync);
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Transfiere un bloque completo entre el dispositivo abierto con O_DIRECT y un buffer. El desplazamiento y el tamaño son
+ * 		múltiplos del tamaño de bloque; si el buffer no está alineado la transferencia se hace a través de un buffer del pool.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+static int directTransfer(int numBloque, char* buffer, int escritura){
+	char* alineado= buffer;
+	if((uintptr_t)buffer % ALINEAMIENTO_BUFFER){
+		alineado= getBlockBuffer();
+		if(alineado==NULL){
+			return -1;
+		}
+		if(escritura){
+			memcpy(alineado, buffer, tamBloque);
+		}
+	}
+
+	int bloqueDispositivo;
+	int fd= fdDirectos[locateBlock(numBloque, &bloqueDispositivo)];
+	off_t desplazamiento= (off_t) bloqueDispositivo*tamBloque;
+	ssize_t transferidos= escritura ? pwrite(fd, alineado, tamBloque, desplazamiento)
+					: pread(fd, alineado, tamBloque, desplazamiento);
+
+	if(alineado!=buffer){
+		if(!escritura && transferidos==tamBloque){
+			memcpy(buffer, alineado, tamBloque);
+		}
+		releaseBlockBuffer(alineado);
+	}
+	return transferidos==tamBloque ? 0 : -1;
+}
+
+/*
+ * @brief 	Abre las imágenes con O_DIRECT. A partir de ese momento readBlock y writeBlock acceden a él directamente, sin pasar
+ * 		por la caché de páginas del sistema.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error (por ejemplo, si el sistema de ficheros que contiene la imagen no admite O_DIRECT).
+ */
+int openDirectDevice(){
+	if(openDevices(fdDirectos, O_RDWR | O_DIRECT)<0){
+		return -1;
+	}
+	accesoDirecto= 1;
+	return 0;
+}
+
+/*
+ * @brief 	Cierra las imágenes abiertas con O_DIRECT (si lo están). Las transferencias vuelven a hacerse con bread/bwrite.
+ */
+void closeDirectDevice(){
+	if(accesoDirecto){
+		closeDevices(fdDirectos);
+		accesoDirecto= 0;
+	}
+}
+
+/*
+ * @brief 	Reserva, en una única zona de memoria alineada, los buffers de bloque que utilizan las operaciones del montaje.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int initBufferPool(){
+	separacionPool= ((tamBloque+ALINEAMIENTO_BUFFER-1)/ALINEAMIENTO_BUFFER)*ALINEAMIENTO_BUFFER;
+	if(posix_memalign((void**)&memoriaPool, ALINEAMIENTO_BUFFER, (size_t) separacionPool*TAM_POOL_BUFFERS)!=0){
+		memoriaPool= NULL;
+		return -1;
+	}
+	int i;
+	for(i=0; i<TAM_POOL_BUFFERS; i++){
+		buffersLibres[i]= memoriaPool+i*separacionPool;
+	}
+	numBuffersLibres= TAM_POOL_BUFFERS;
+	peticionesBuffer= 0;
+	reservasHeap= 0;
+	return 0;
+}
+
+/*
+ * @brief 	Libera los buffers de bloque del montaje.
+ */
+void destroyBufferPool(){
+	free(memoriaPool);
+	memoriaPool= NULL;
+	numBuffersLibres= 0;
+}
+
+/*
+ * @brief 	Obtiene un buffer de bloque alineado del pool. Si el pool está agotado se reserva un buffer alineado adicional.
+ * @return 	Buffer de tamBloque bytes, NULL si se produce algún error.
+ */
+char* getBlockBuffer(){
+	char* buffer= NULL;
+	pthread_mutex_lock(&mutexPool);
+	peticionesBuffer++;
+	if(numBuffersLibres>0){
+		buffer= buffersLibres[--numBuffersLibres];
+	}
+	else{
+		reservasHeap++;
+	}
+	pthread_mutex_unlock(&mutexPool);
+	if(buffer==NULL && posix_memalign((void**)&buffer, ALINEAMIENTO_BUFFER, tamBloque)!=0){
+		return NULL;
+	}
+	return buffer;
+}
+
+/*
+ * @brief 	Devuelve al pool un buffer obtenido con getBlockBuffer. Los buffers adicionales se liberan.
+ */
+void releaseBlockBuffer(char* buffer){
+	if(memoriaPool!=NULL && buffer>=memoriaPool && buffer<memoriaPool+separacionPool*TAM_POOL_BUFFERS){
+		pthread_mutex_lock(&mutexPool);
+		buffersLibres[numBuffersLibres++]= buffer;
+		pthread_mutex_unlock(&mutexPool);
+	}
+	else{
+		free(buffer);
+	}
+}
+
+/*
+ * @brief 	Lee un bloque del sistema de ficheros, formado por sectoresBloque bloques consecutivos del dispositivo. El caso más
+ * 		habitual, en el que el tamaño de bloque coincide con el del dispositivo, se resuelve con una única lectura.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int readBlock(int numBloque, char* buffer){
+	if(accesoDirecto){
+		return directTransfer(numBloque, buffer, 0);
+	}
+	int bloqueDispositivo;
+	char* dispositivo= dispositivos[locateBlock(numBloque, &bloqueDispositivo)];
+	if(tamBloque==BLOCK_SIZE){
+		return bread(dispositivo, bloqueDispositivo, buffer);
+	}
+	int sectores= tamBloque/BLOCK_SIZE;
+	int i;
+	for(i=0; i<sectores; i++){
+		if(bread(dispositivo, bloqueDispositivo*sectores+i, buffer+i*BLOCK_SIZE)<0){
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Escribe un bloque del sistema de ficheros, formado por sectoresBloque bloques consecutivos del dispositivo. El caso
+ * 		más habitual, en el que el tamaño de bloque coincide con el del dispositivo, se resuelve con una única escritura.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int writeBlock(int numBloque, char* buffer){
+	if(accesoDirecto){
+		return directTransfer(numBloque, buffer, 1);
+	}
+	int bloqueDispositivo;
+	char* dispositivo= dispositivos[locateBlock(numBloque, &bloqueDispositivo)];
+	if(tamBloque==BLOCK_SIZE){
+		return bwrite(dispositivo, bloqueDispositivo, buffer);
+	}
+	int sectores= tamBloque/BLOCK_SIZE;
+	int i;
+	for(i=0; i<sectores; i++){
+		if(bwrite(dispositivo, bloqueDispositivo*sectores+i, buffer+i*BLOCK_SIZE)<0){
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Lee un bloque de metadatos teniendo en cuenta la marca de agua del superbloque.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error. Los bloques no inicializados se devuelven a ceros sin leer el disco.
+ */
+int readInodeBlock(int numBloque, char* buffer){
+	if(numBloque>=s_bloque.bloquesIniciados){
+		memset(buffer, 0, tamBloque);
+		return 0;
+	}
+	return readBlock(numBloque, buffer);
+}
+
+/*
+ * @brief 	Busca en la caché de lectura la entrada que contiene un bloque de datos. Se debe llamar con mutexCache adquirido.
+ * @return 	Índice de la entrada si el bloque está en caché (válido o cargándose), -1 en caso contrario.
+ */
+static int findCachedBlock(int numBloque){
+	int i;
+	for(i=0; i<CACHE_BLOQUES; i++){
+		if(cacheLectura[i].estado && cacheLectura[i].numBloque==numBloque){
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+ * @brief 	Elige una entrada de la caché para alojar un bloque nuevo. Se debe llamar con mutexCache adquirido.
+ * @return 	Índice de una entrada libre o de la entrada válida a reemplazar, -1 si todas se están cargando.
+ */
+static int victimCacheEntry(){
+	int i;
+	for(i=0; i<CACHE_BLOQUES; i++){
+		if(!cacheLectura[i].estado){
+			return i;
+		}
+	}
+	for(i=0; i<CACHE_BLOQUES; i++){
+		int entrada= (manecillaCache+i)%CACHE_BLOQUES;
+		if(cacheLectura[entrada].estado==2){
+			manecillaCache= (entrada+1)%CACHE_BLOQUES;
+			return entrada;
+		}
+	}
+	return -1;
+}
+
+/*
+ * @brief 	Hilo de precarga. Lee en segundo plano los bloques solicitados por prefetchFiles y los deja en la caché de lectura.
+ * @return 	NULL al detenerse el hilo.
+ */
+static void* readaheadWorker(void* arg){
+	(void) arg;
+	pthread_mutex_lock(&mutexCache);
+	while(1){
+		while(readaheadActivo && !numPendientes){
+			pthread_cond_wait(&condPrecarga, &mutexCache);
+		}
+		if(!readaheadActivo){
+			break;
+		}
+
+		/* Extracción de la siguiente petición. Se descarta si el bloque ya está en caché o no hay entrada disponible. */
+		int numBloque= colaPrecarga[inicioCola];
+		inicioCola= (inicioCola+1)%COLA_READAHEAD;
+		numPendientes--;
+		if(findCachedBlock(numBloque)>=0){
+			continue;
+		}
+		int entrada= victimCacheEntry();
+		if(entrada<0){
+			continue;
+		}
+		cacheLectura[entrada].numBloque= numBloque;
+		cacheLectura[entrada].estado= 1;
+		cacheLectura[entrada].invalidado= 0;
+
+		/* Lectura del bloque sin mantener el cerrojo para que el hilo principal siga sirviendo peticiones */
+		pthread_mutex_unlock(&mutexCache);
+		int ret= readBlock(numBloque, cacheLectura[entrada].datos);
+		pthread_mutex_lock(&mutexCache);
+
+		/* Si la lectura falla o el bloque se ha escrito mientras tanto la copia cargada no es válida */
+		if(ret<0 || cacheLectura[entrada].invalidado){
+			cacheLectura[entrada].estado= 0;
+			cacheLectura[entrada].numBloque= -1;
+		}
+		else{
+			cacheLectura[entrada].estado= 2;
+		}
+		pthread_cond_broadcast(&condCargado);
+	}
+	pthread_mutex_unlock(&mutexCache);
+	return NULL;
+}
+
+/*
+ * @brief 	Reserva la caché de lectura y arranca el hilo de precarga.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int initReadahead(){
+	int i;
+	for(i=0; i<CACHE_BLOQUES; i++){
+		cacheLectura[i].numBloque= -1;
+		cacheLectura[i].estado= 0;
+		cacheLectura[i].invalidado= 0;
+		if(posix_memalign((void**)&(cacheLectura[i].datos), ALINEAMIENTO_BUFFER, tamBloque)!=0){
+			cacheLectura[i].datos= NULL;
+			destroyReadahead();
+			return -1;
+		}
+	}
+	manecillaCache= 0;
+	inicioCola= 0;
+	numPendientes= 0;
+	ultimoBloqueLeido= -1;
+	ventanaReadahead= 0;
+
+	readaheadActivo= 1;
+	if(pthread_create(&hiloPrecarga, NULL, readaheadWorker, NULL)!=0){
+		readaheadActivo= 0;
+		destroyReadahead();
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * @brief 	Detiene el hilo de precarga, espera a que termine y libera la caché de lectura.
+ */
+void destroyReadahead(){
+	if(readaheadActivo){
+		pthread_mutex_lock(&mutexCache);
+		readaheadActivo= 0;
+		pthread_cond_signal(&condPrecarga);
+		pthread_mutex_unlock(&mutexCache);
+		pthread_join(hiloPrecarga, NULL);
+	}
+	int i;
+	for(i=0; i<CACHE_BLOQUES; i++){
+		free(cacheLectura[i].datos);
+		cacheLectura[i].datos= NULL;
+		cacheLectura[i].estado= 0;
+		cacheLectura[i].numBloque= -1;
+	}
+	numPendientes= 0;
+}
+
+/*
+ * @brief 	Copia numBytes del bloque de datos numBloque a partir de offset. Si el bloque está en caché se sirve desde ella,
+ * 		si se está precargando se espera a que termine la carga y si no está se lee de disco y se guarda en la caché.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int readDataBlock(int numBloque, int offset, void* buffer, int numBytes){
+	pthread_mutex_lock(&mutexCache);
+	int entrada= findCachedBlock(numBloque);
+	while(entrada>=0 && cacheLectura[entrada].estado==1){
+		pthread_cond_wait(&condCargado, &mutexCache);
+		entrada= findCachedBlock(numBloque);
+	}
+	if(entrada>=0){
+		memcpy(buffer, cacheLectura[entrada].datos+offset, numBytes);
+		pthread_mutex_unlock(&mutexCache);
+		return 0;
+	}
+	pthread_mutex_unlock(&mutexCache);
+
+	/* Fallo de caché: lectura síncrona del bloque */
+	char* b_aux= getBlockBuffer();
+	if(b_aux==NULL){
+		return -1;
+	}
+	if(readBlock(numBloque, b_aux)<0){
+		releaseBlockBuffer(b_aux);
+		return -1;
+	}
+	memcpy(buffer, b_aux+offset, numBytes);
+
+	/* Si el bloque no se ha empezado a precargar mientras tanto se aloja en la caché para las lecturas siguientes */
+	pthread_mutex_lock(&mutexCache);
+	if(findCachedBlock(numBloque)<0){
+		entrada= victimCacheEntry();
+		if(entrada>=0){
+			memcpy(cacheLectura[entrada].datos, b_aux, tamBloque);
+			cacheLectura[entrada].numBloque= numBloque;
+			cacheLectura[entrada].estado= 2;
+		}
+	}
+	pthread_mutex_unlock(&mutexCache);
+	releaseBlockBuffer(b_aux);
+	return 0;
+}
+
+/*
+ * @brief 	Mantiene la caché de lectura coherente con el disco tras escribir un bloque de datos. Si el bloque está en caché
+ * 		se actualiza su copia y si se está precargando se invalida la carga en curso.
+ */
+void updateCachedBlock(int numBloque, char* buffer){
+	pthread_mutex_lock(&mutexCache);
+	int entrada= findCachedBlock(numBloque);
+	if(entrada>=0){
+		if(cacheLectura[entrada].estado==2){
+			memcpy(cacheLectura[entrada].datos, buffer, tamBloque);
+		}
+		else{
+			cacheLectura[entrada].invalidado= 1;
+		}
+	}
+	pthread_mutex_unlock(&mutexCache);
+}
+
+/*
+ * @brief 	Solicita al hilo de precarga los numFicheros bloques de datos que siguen en disco al del fichero idFile. Sólo se
+ * 		piden los bloques asignados a algún fichero y que no están ya en caché. Se debe llamar con mutexInodos adquirido.
+ */
+void prefetchFiles(int idFile, int numFicheros){
+	if(ArrayInodos[idFile].sinEscribir){
+		return;
+	}
+	pthread_mutex_lock(&mutexCache);
+	int i;
+	for(i=ArrayInodos[idFile].bloqueDatos+1; i<=ArrayInodos[idFile].bloqueDatos+numFicheros && i<s_bloque.numBloquesDatos; i++){
+		if(!mapaBloques[i]){
+			continue;
+		}
+		int numBloque= getPrimerBloqueDatos()+i;
+		if(findCachedBlock(numBloque)>=0 || numPendientes==COLA_READAHEAD){
+			continue;
+		}
+		colaPrecarga[(inicioCola+numPendientes)%COLA_READAHEAD]= numBloque;
+		numPendientes++;
+	}
+	if(numPendientes){
+		pthread_cond_signal(&condPrecarga);
+	}
+	pthread_mutex_unlock(&mutexCache);
+}
+
+/*
+ * @brief 	Compara los nombres de dos ficheros a partir de sus identificadores. Utilizada por qsort para ordenar el índice.
+ * @return 	Menor, igual o mayor que 0 según el orden alfabético de los nombres.
+ */
+static int compareNames(const void* a, const void* b){
+	return strcmp(getFileName(*(const int*)a), getFileName(*(const int*)b));
+}
+
+/*
+ * @brief 	Construye el índice ordenado por nombre a partir de los Inodos ocupados.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce algún error.
+ */
+int buildNameIndex(){
+	if(indiceNombres==NULL){
+		indiceNombres= (int*) malloc(sizeof(int)*(s_bloque.numInodos>0 ? s_bloque.numInodos : 1));
+		if(indiceNombres==NULL){
+			return -1;
+		}
+	}
+	numIndiceNombres= 0;
+	int i;
+	for(i=0; i<s_bloque.numInodos; i++){
+		if(mapaInodos[i]){
+			indiceNombres[numIndiceNombres++]= i;
+		}
+	}
+	qsort(indiceNombres, numIndiceNombres, sizeof(int), compareNames);
+	return 0;
+}
+
+/*
+ * @brief 	Libera el índice ordenado por nombre.
+ */
+void destroyNameIndex(){
+	free(indiceNombres);
+	indiceNombres= NULL;
+	numIndiceNombres= 0;
+}
+
+/*
+ * @brief 	Búsqueda binaria en el índice ordenado por nombre.
+ * @return 	Primera posición del índice cuyo nombre es mayor o igual que fileName (numIndiceNombres si no hay ninguna).
+ */
+int searchNameIndex(char* fileName){
+	int inicio= 0;
+	int fin= numIndiceNombres;
+	while(inicio<fin){
+		int medio= inicio+(fin-inicio)/2;
+		if(strcmp(getFileName(indiceNombres[medio]), fileName)<0){
+			inicio= medio+1;
+		}
+		else{
+			fin= medio;
+		}
+	}
+	return inicio;
+}
+
+/*
+ * @brief 	Inserta en su posición del índice ordenado el fichero con identificador idFile.
+ */
+void insertNameIndex(int idFile){
+	int pos= searchNameIndex(getFileName(idFile));
+	memmove(indiceNombres+pos+1, indiceNombres+pos, sizeof(int)*(numIndiceNombres-pos));
+	indiceNombres[pos]= idFile;
+	numIndiceNombres++;
+}
+
+/*
+ * @brief 	Elimina del índice ordenado el fichero con identificador idFile. Se debe llamar antes de borrar su nombre del Inodo.
+ */
+void removeNameIndex(int idFile){
+	int pos= searchNameIndex(getFileName(idFile));
+	if(pos<numIndiceNombres && indiceNombres[pos]==idFile){
+		memmove(indiceNombres+pos, indiceNombres+pos+1, sizeof(int)*(numIndiceNombres-pos-1));
+		numIndiceNombres--;
+	}
+}
+
+/*
+ * @brief 	Calcula el valor hash de un nombre de fichero (djb2).
+ * @return 	Valor hash del nombre.
+ */
+static unsigned int hashName(const char* nombre){
+	unsigned int hash= 5381;
+	while(*nombre){
+		hash= hash*33 + (unsigned char)*nombre++;
+	}
+	return hash;
+}
+
+/*
+ * @brief 	Construye una tabla hash de direccionamiento abierto con los nombres de los ficheros existentes. Cada posición guarda
+ * 		el identificador de un fichero o -1 si está vacía. Se reserva espacio para numExtra nombres adicionales.
+ * @return 	La tabla (que debe liberar quien la llama) y su tamaño en tamTabla, NULL si se produce algún error.
+ */
+int* buildNameTable(int numExtra, int* tamTabla){
+	int tam= 16;
+	while(tam < 2*(s_bloque.numInodos+numExtra)){
+		tam*= 2;
+	}
+	int* tabla= (int*) malloc(sizeof(int)*tam);
+	if(tabla==NULL){
+		return NULL;
+	}
+	memset(tabla, 0xff, sizeof(int)*tam);
+	*tamTabla= tam;
+
+	int i;
+	for(i=0; i<s_bloque.numInodos; i++){
+		if(mapaInodos[i]){
+			insertNameTable(tabla, tam, i);
+		}
+	}
+	return tabla;
+}
+
+/*
+ * @brief 	Busca un nombre de fichero en una tabla hash construida con buildNameTable.
+ * @return 	Identificador del fichero con ese nombre, -1 si no está en la tabla.
+ */
+int lookupNameTable(int* tabla, int tamTabla, char* fileName){
+	unsigned int pos= hashName(fileName) & (tamTabla-1);
+	while(tabla[pos]!=-1){
+		if(!strcmp(getFileName(tabla[pos]), fileName)){
+			return tabla[pos];
+		}
+		pos= (pos+1) & (tamTabla-1);
+	}
+	return -1;
+}
+
+/*
+ * @brief 	Añade a una tabla hash construida con buildNameTable el nombre del fichero con identificador idFile.
+ */
+void insertNameTable(int* tabla, int tamTabla, int idFile){
+	unsigned int pos= hashName(getFileName(idFile)) & (tamTabla-1);
+	while(tabla[pos]!=-1){
+		pos= (pos+1) & (tamTabla-1);
+	}
+	tabla[pos]= idFile;
+}
+
+/*
+ * @brief 	Proyecta en memoria, en modo sólo lectura, la imagen completa número dispositivo. La proyección es compartida, por lo que
+ * 		refleja las escrituras posteriores sobre la imagen. Sólo se realiza la primera vez que se llama para cada imagen.
+ * @return 	Dirección del bloque 0 de la imagen proyectada, NULL si se produce algún error. En tamanyo se guarda el número de bytes proyectados.
+ */
+char* mapDeviceImage(int dispositivo, size_t* tamanyo){
+	if(imagenesMapeadas[dispositivo]!=NULL){
+		*tamanyo= tamImagenesMapeadas[dispositivo];
+		return imagenesMapeadas[dispositivo];
+	}
+
+	int fd= open(dispositivos[dispositivo], O_RDONLY);
+	if(fd<0){
+		return NULL;
+	}
+	struct stat infoDisco;
+	if(fstat(fd, &infoDisco)<0 || infoDisco.st_size<=0){
+		close(fd);
+		return NULL;
+	}
+	void* imagen= mmap(NULL, infoDisco.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(imagen==MAP_FAILED){
+		return NULL;
+	}
+
+	imagenesMapeadas[dispositivo]= (char*) imagen;
+	tamImagenesMapeadas[dispositivo]= infoDisco.st_size;
+	*tamanyo= tamImagenesMapeadas[dispositivo];
+	return imagenesMapeadas[dispositivo];
+}
+
+/*
+ * @brief 	Libera las proyecciones en memoria de las imágenes.
+ */
+void unmapDeviceImage(){
+	int i;
+	for(i=0; i<MAX_DISPOSITIVOS; i++){
+		if(imagenesMapeadas[i]!=NULL){
+			munmap(imagenesMapeadas[i], tamImagenesMapeadas[i]);
+			imagenesMapeadas[i]= NULL;
+			tamImagenesMapeadas[i]= 0;
+		}
+	}
+}
@@ -10,17 +10,110 @@ typedef struct{
 	int estado;     // Estado del descriptor. 1 está en uso y 0 no lo está.
 	int idFichero;  // Identificador del fichero. Se corresponde con la posición del Inodo en el vector de Inodos.
 	int posicion;   // Puntero de posición del fichero.
+	int finLectura; // Posición en la que terminó la última lectura del descriptor. Sirve para detectar accesos secuenciales. -1 si no se ha leído.
+	int mapeado;    // 1 si el descriptor tiene una proyección activa obtenida con mapFile.
+	int siguiente;  // Siguiente descriptor de la lista en la que está el descriptor: la de descriptores libres o la de descriptores abiertos del mismo fichero. -1 si es el último.
 }Descriptor;		// Estructura de descriptores. Sirve para saber que ficheros están abiertos y su puntero de posición.
 
-Descriptor* ArrayDescriptores;	// Conjunto de descriptores utilizados
-int iNodosPrimerBloque;		// Número de Inodos en el primer bloque de disco.
-int iNodosExtra;		// Número de Inodos en el segundo bloque de disco.
+#define TAM_POOL_BUFFERS 8	// Número de buffers de bloque alineados reservados al montar
+#define NUM_DESCRIPTORES 16	// Número de descriptores del pool si no se indica otro al montar
+#define ALINEAMIENTO_BUFFER 4096	// Alineamiento de los buffers de bloque, necesario para el acceso directo (O_DIRECT) al dispositivo
+#define READAHEAD_MAX 8		// Número máximo de bloques que se precargan por delante de una lectura secuencial
+#define CACHE_BLOQUES 16	// Número de bloques de datos que se mantienen en la caché de lectura
+#define COLA_READAHEAD 32	// Número máximo de peticiones de precarga pendientes
+#define TAM_SEGMENTO 8		// Número de bloques de datos de cada segmento del registro (modo log-structured)
+#define SEGMENTOS_LIMPIOS_MIN 2	// Número de segmentos libres por debajo del cual el limpiador del registro compacta segmentos
+#define INTERVALO_LIMPIADOR 100	// Intervalo en milisegundos con el que el limpiador del registro comprueba si tiene que compactar
+
+typedef struct{
+	int numBloque;		// Bloque de datos almacenado en la entrada. -1 si está libre.
+	int estado;		// 0 libre, 1 cargándose en segundo plano, 2 válido.
+	int invalidado;		// 1 si el bloque se ha escrito mientras se estaba cargando. La carga en curso se descarta.
+	char* datos;		// Contenido del bloque.
+}EntradaCache;			// Entrada de la caché de bloques de datos que alimenta la precarga (readahead).
+
+typedef struct{
+	int aperturas;	// Número de descriptores abiertos sobre el fichero.
+	int primerDesc;	// Primer descriptor de la lista de descriptores abiertos sobre el fichero. -1 si no está abierto.
+	unsigned int sectoresModificados;	// Máscara de los sectores del bloque de datos escritos desde la última vez que se calculó su CRC. Sus CRC en el Inodo no están actualizados hasta cerrarlo.
+	int cuarentena;	// 1 si la verificación en segundo plano ha encontrado el fichero corrupto y no se puede abrir hasta que se reemplace o se borre.
+}EstadoInodo;		// Estado en memoria de cada fichero. Permite saber en O(1) si está abierto y con qué descriptores.
+
+Descriptor* ArrayDescriptores;	// Pool de descriptores. Su tamaño es independiente del número de Inodos.
+int numDescriptores;		// Número de descriptores del pool.
+int primerDescLibre;		// Primer descriptor de la lista de descriptores libres. -1 si no queda ninguno.
+EstadoInodo* ArrayEstados;	// Estado en memoria de cada Inodo, indexado por identificador de fichero.
+int bloquesMetadatos;		// Número de bloques de disco de metadatos (1 o 2).
+int tamMontonNombres;		// Capacidad del montón de nombres, en bytes. Depende del tamaño de bloque, del número de Inodos y de bloques de metadatos.
+int tamBloque;			// Tamaño de bloque del sistema de ficheros, en bytes. Se elige al formatear y se lee del superbloque al montar.
+int tamSector;			// Tamaño de los sectores sobre los que se calcula el CRC de los bloques de datos (tamBloque/NUM_SECTORES_CRC).
 
 int findFilebyName(char *fileName); // Busca un fichero en el disco por su nombre, si lo encuentra devuelve su identificador, si no devuelve -1.
 int isOpen(int idFile); 	// Dice si el fichero con identificador idFile está abierto. Devuelve 1 si está abierto y 0 si está cerrado.
+int isMapped(int idFile);	// Dice si el fichero con identificador idFile está proyectado con mapFile en alguno de sus descriptores. Devuelve 1 si lo está y 0 si no.
 int firstFreeDesc(); 		// Devuelve el primer descriptor libre. Devuelve -1 si no hay ninguno libre.
 int firstFreeInode();  		// Devuelve el identificador del primer Inodo libre. Devuelve -1 si no hay ningún inodo libre.
+int firstFreeBlock(int desde);	// Devuelve el primer bloque de datos libre (relativo al primer bloque de datos) a partir de desde, volviendo al principio al llegar al final. Devuelve -1 si no hay ninguno libre.
+int allocBlock(int idFile);	// Reserva en el mapa de bloques un bloque de datos libre para el fichero idFile, junto al del fichero anterior en orden de nombre (en modo registro, en la cabeza del registro). Devuelve el bloque reservado, -1 si no hay ninguno libre.
+void freeBlock(int bloque);	// Libera en el mapa de bloques el bloque de datos indicado (relativo al primer bloque de datos).
+int getPrimerBloqueDatos();	// Devuelve el número de bloque de disco del primer bloque de datos.
+char* getFileName(int idFile);	// Devuelve el nombre del fichero con identificador idFile, guardado en el montón de nombres.
+int initNameHeap();		// Calcula la capacidad del montón de nombres a partir del superbloque y lo reserva vacío. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+int appendName(char* nombre);	// Añade un nombre al final del montón de nombres, compactándolo si no queda espacio. Devuelve su posición en el montón, -1 si no cabe.
+void releaseNames(int posicion);	// Descarta los nombres añadidos al final del montón de nombres desde posicion, al deshacer creaciones fallidas.
+void compactNameHeap();		// Compacta el montón de nombres sobre sí mismo, dejando seguidos los nombres de los ficheros existentes y descartando los de los borrados.
+int readMetadataBlocks(char* r_bloque, void* inodos, char* monton);	// Copia los Inodos y el montón de nombres de los bloques de metadatos del disco. r_bloque contiene el bloque 0 ya leído. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+int compareDiskName(const char* nombre, const char* bloque0, const char* bloque1, int posicion);	// Compara un nombre con el que empieza en posicion en el montón de nombres de los bloques de metadatos del disco (bloque1 NULL si no hay segundo bloque). Devuelve 1 si son iguales, 0 en caso contrario.
 int writeMetadata(); 		// Escribe los metadatos de memoria al disco. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
-int findDescFile(int idFile);	// Busca el descriptor asociado a un fichero. Devuelve el descriptor de un fichero con identificador idFile. Si no lo encuentra devuelve -1.
-int getNumBloque(int idFile);   // Busca el número de bloque en el que se encuentra un fichero. Devuelve el número de bloque de datos correspondiente al fichero con identificador idFile. Si no lo encuentra  devuelve -1.
+int writeMetadataBlocks(unsigned long* escritura);	// Escribe los bloques de metadatos sin aplicar la política de durabilidad y devuelve en escritura el número de la escritura. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+int commitMetadata(unsigned long escritura);	// Aplica la política de durabilidad a los metadatos escritos con writeMetadataBlocks, sin el cerrojo de los Inodos, y perfora los bloques que liberan. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+int findDescFile(int idFile);	// Busca el descriptor asociado a un fichero. Devuelve el primero de los descriptores abiertos sobre el fichero con identificador idFile. Si no lo encuentra devuelve -1.
+int getNumBloque(int idFile);   // Busca el número de bloque en el que se encuentra un fichero. Devuelve el número de bloque de datos correspondiente al fichero con identificador idFile. Si no tiene bloque asignado devuelve -1.
+int writeSuperblock();		// Actualiza el CRC de los metadatos y escribe a disco el primer bloque de metadatos (superbloque, mapas de Inodos y de bloques, CRC, Inodos y la parte del montón de nombres que cabe en él). Devuelve -1 si se produce error y 0 si se ejecuta con éxito.
 int updateCRCMetadata();	// Actualiza el valor del CRC de los metadatos. Devuelve -1 si se produce error y 0 si se ejecuta con éxito.
+int verifySectors(int idFile, char* datos, int primerSector, int numSectores);	// Comprueba el CRC de los sectores no modificados del fichero idFile a partir del contenido de esos sectores. Devuelve 0 si son correctos, -1 si alguno está corrupto.
+void markModifiedSectors(int idFile, int offset, int numBytes);	// Marca como modificados los sectores del fichero idFile que contienen el rango de bytes indicado.
+int initBufferPool();		// Reserva los buffers de bloque alineados del montaje. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+void destroyBufferPool();	// Libera los buffers de bloque alineados del montaje.
+char* getBlockBuffer();		// Obtiene un buffer de bloque alineado de tamBloque bytes. Devuelve NULL si se produce algún error.
+void releaseBlockBuffer(char* buffer);	// Devuelve un buffer obtenido con getBlockBuffer.
+int openDirectDevice();		// Abre las imágenes con O_DIRECT para que readBlock y writeBlock accedan a él sin pasar por la caché de páginas. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+void closeDirectDevice();	// Cierra las imágenes abiertas con O_DIRECT (si lo están).
+int commitModifiedSectors(int idFile);	// Recalcula el CRC de los sectores modificados del fichero idFile y escribe los metadatos. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+int initDurability(int politica, int intervaloMs);	// Abre las imágenes para hacer fsync y arranca el hilo de sincronización periódica si la política lo requiere. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+void destroyDurability();	// Detiene el hilo de sincronización periódica (sincronizando lo pendiente) y cierra las imágenes.
+int syncDevice();		// Hace fsync de todas las imágenes. Las llamadas concurrentes se agrupan tras un único fsync. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+int metadataCommitted();	// Aplica la política de durabilidad tras escribir los metadatos. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+void releaseMountState();	// Detiene los hilos del montaje y libera todas las variables del sistema de ficheros, aunque el montaje se haya quedado a medias.
+int verifyMetadata();		// Comprueba el CRC de los metadatos guardados en disco. Devuelve 0 si son correctos, -1 si están corruptos y -2 si se produce algún error.
+int initScrubber(const FSMountOptions *options);	// Arranca el hilo de verificación en segundo plano. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+void destroyScrubber();		// Detiene el hilo de verificación en segundo plano y espera a que termine.
+int appendLogBlock(int segmentoExcluido);	// Reserva el siguiente bloque libre de la cabeza del registro, fuera del segmento segmentoExcluido (-1 para ninguno). Devuelve el bloque reservado, -1 si no hay ninguno libre.
+void retireLogBlock(int bloque);	// Marca un bloque sustituido en el registro para liberarlo con la siguiente escritura de los metadatos.
+int cleanLog();			// Compacta el segmento del registro con menos bloques vivos si quedan pocos segmentos libres. Devuelve el número de bloques movidos, -1 si se produce algún error.
+int initCleaner();		// Arranca el hilo limpiador del registro. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+void destroyCleaner();		// Detiene el hilo limpiador del registro y espera a que termine.
+int setDevices(const char** nombres, int num);	// Fija las imágenes sobre las que trabaja el sistema de ficheros. Con nombres NULL se usa DEVICE_IMAGE. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+int locateBlock(int numBloque, int* bloqueDispositivo);	// Traduce un bloque del sistema de ficheros a la imagen que lo contiene y a su posición en ella. Devuelve el índice de la imagen.
+int punchBlock(int bloque, const char* libres);	// Devuelve a la imagen el espacio del bloque de datos indicado (relativo al primer bloque de datos) y el de los bloques contiguos libres en memoria y en libres. Devuelve 0 si se ejecuta con éxito, -1 si no se ha liberado el espacio.
+int punchImages(int primerBloque, int ultimoBloque);	// Perfora en todas las imágenes un hueco entre los bloques primerBloque y ultimoBloque (sin incluirlo). Devuelve 0 si se ejecuta con éxito, -1 si no se ha liberado el espacio.
+int readBlock(int numBloque, char* buffer);	// Lee un bloque del sistema de ficheros (de tamBloque bytes). Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+int writeBlock(int numBloque, char* buffer);	// Escribe un bloque del sistema de ficheros (de tamBloque bytes). Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+int readInodeBlock(int numBloque, char* buffer);	// Lee el bloque de metadatos numBloque. Si aún no se ha inicializado en disco devuelve un bloque a ceros sin acceder al dispositivo. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+int initReadahead();		// Reserva la caché de lectura y arranca el hilo de precarga. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+void destroyReadahead();	// Detiene el hilo de precarga y libera la caché de lectura.
+int readDataBlock(int numBloque, int offset, void* buffer, int numBytes);	// Copia numBytes del bloque de datos numBloque desde offset, usando la caché si está disponible. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+void updateCachedBlock(int numBloque, char* buffer);	// Actualiza la copia en caché de un bloque de datos recién escrito en disco.
+void prefetchFiles(int idFile, int numFicheros);	// Solicita la precarga en segundo plano de los numFicheros bloques de datos asignados que siguen en disco al del fichero idFile.
+void linkDesc(int descriptor, int idFile);	// Saca el descriptor de la lista de libres y lo añade a la lista de descriptores abiertos del fichero idFile.
+void unlinkDesc(int descriptor);	// Saca el descriptor de la lista de descriptores abiertos de su fichero y lo devuelve a la lista de libres.
+int buildNameIndex();		// Construye el índice ordenado por nombre de los ficheros existentes. Devuelve 0 si se ejecuta con éxito, -1 si se produce algún error.
+void destroyNameIndex();	// Libera el índice ordenado por nombre.
+int searchNameIndex(char* fileName);	// Busca por búsqueda binaria la primera posición del índice cuyo nombre no es menor que fileName.
+void insertNameIndex(int idFile);	// Añade al índice ordenado el fichero con identificador idFile.
+void removeNameIndex(int idFile);	// Elimina del índice ordenado el fichero con identificador idFile.
+int* buildNameTable(int numExtra, int* tamTabla);	// Construye una tabla hash temporal con los nombres de los ficheros existentes, con hueco para numExtra nombres más. Devuelve la tabla y su tamaño en tamTabla, NULL si se produce algún error.
+int lookupNameTable(int* tabla, int tamTabla, char* fileName);	// Busca un nombre en la tabla hash. Devuelve el identificador del fichero o -1 si no está.
+void insertNameTable(int* tabla, int tamTabla, int idFile);	// Añade a la tabla hash el nombre del fichero con identificador idFile.
+char* mapDeviceImage(int dispositivo, size_t* tamanyo);	// Proyecta en memoria la imagen dispositivo (sólo la primera vez) y guarda en tamanyo los bytes proyectados. Devuelve la dirección de su bloque 0, NULL si se produce algún error.
+void unmapDeviceImage();	// Libera las proyecciones en memoria de las imágenes.
@@ -0,0 +1,51 @@
+/*
+ * OPERATING SYSTEMS DESING - 16/17
+ *
+ * @file 	client.h
+ * @brief 	Interface of the client of the file system server. client.c implements the functions of filesystem.h by sending
+ * 		them to the server, so a program linked with client.c instead of filesystem.c shares the file system mounted by
+ * 		the server with other processes. mountFS and mountFSOptions connect to the server at FS_SOCKET and unmountFS
+ * 		disconnects, closing the files left open. mkFS is not available while the server owns the device, and mapFile
+ * 		always fails. The client is not thread safe.
+ * @date	01/03/2017
+ */
+
+#ifndef _CLIENT_H_
+#define _CLIENT_H_
+
+#include "protocol.h"		// Protocol between the server and its clients
+
+/*
+ * @brief	Connects to the file system server listening on <socketPath> and shares with it a memory region for large transfers.
+ * @return	0 if success, -1 otherwise.
+ */
+int connectFS(const char *socketPath);
+
+/*
+ * @brief	Disconnects from the file system server. The server closes the files left open by this process.
+ * @return	0 if success, -1 otherwise.
+ */
+int disconnectFS(void);
+
+/*
+ * @brief	Sends a request without waiting for its response, so that several requests can be in flight at once. <data> holds
+ * 		the <request->longitudDatos> bytes that follow the header. The id of the request is assigned by this function.
+ * @return	The id of the request, -1 in case of error.
+ */
+long submitRequest(Peticion *request, const void *data);
+
+/*
+ * @brief	Waits for the response to the oldest request in flight. The server answers the requests in the order they were
+ * 		sent. Up to <size> bytes of the response data are stored in <data>; the rest are discarded.
+ * @return	0 if success, -1 in case of error.
+ */
+int waitResponse(Respuesta *response, void *data, int size);
+
+/*
+ * @brief	Gets the memory shared with the server, for requests with the compartida flag set. The functions of filesystem.h
+ * 		use its first bytes, so pipelined transfers must not be in flight when they are called.
+ * @return	Pointer to the shared memory and its size in <size>, NULL if there is no shared memory.
+ */
+char *getSharedMemory(int *size);
+
+#endif
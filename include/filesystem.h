@@ -14,10 +14,59 @@
 #include "blocks_cache.h"	// Headers for block managing (read/write)
 
 #define DEVICE_IMAGE "disk.dat"		// Device name
-#define MAX_FILE_SIZE 2048			// Maximum file size, in bytes
 #define FS_SEEK_CUR 0
 #define FS_SEEK_END 1
 #define FS_SEEK_BEGIN 2
+#define FS_DURABILITY_NONE 0		// Never fsync the device (only syncFile, syncFS and unmountFS do)
+#define FS_DURABILITY_ON_CLOSE 1	// fsync when a modified file is closed
+#define FS_DURABILITY_ON_COMMIT 2	// fsync on every metadata commit, before the call returns. If that fsync fails the call returns an error but the change is kept.
+#define FS_DURABILITY_GROUP 3		// fsync pending commits in the background every groupCommitMs milliseconds
+
+/* Format options for mkFSOptions. A NULL pointer or a field set to 0 selects the default value. */
+typedef struct{
+	int blockSize;		// Size of the file system blocks, in bytes: a power of two from BLOCK_SIZE (default) to 65536. It is also the maximum file size.
+	const char **devices;	// Backing images across which the data blocks are striped, up to 8. The metadata lives in the first one. Default { DEVICE_IMAGE }.
+	int numDevices;		// Number of entries in devices.
+	int numInodes;		// Maximum number of files, from 1 to 64, independent of the number of data blocks. Default one per data block, up to 64.
+	int logStructured;	// 1 to append every data block write at the head of a log, compacted by a background cleaner, instead of updating blocks in place. Default 0.
+}FSOptions;
+
+/* Mount options for mountFSOptions. A NULL pointer or a field set to 0 selects the default value. */
+typedef struct{
+	int directIO;		// 1 to access the device with O_DIRECT, bypassing the page cache of the host. Default 0.
+	int durability;		// One of the FS_DURABILITY_* policies. Default FS_DURABILITY_NONE.
+	int groupCommitMs;	// Interval of the background fsync with FS_DURABILITY_GROUP, in milliseconds. Default 5.
+	const char **devices;	// Backing images of the file system, in the same order given to mkFSOptions. Default { DEVICE_IMAGE }.
+	int numDevices;		// Number of entries in devices.
+	int scrubRate;		// Blocks per second verified by a background scrubber at idle priority. Default 0 (no scrubber). Mount still checks the metadata CRC, in memory, after an unclean shutdown.
+	int scrubQuarantine;	// 1 to make openFile fail with -2 on files the scrubber found corrupted, until they are replaced or removed. Default 0.
+	void (*scrubReport)(const char *fileName, void *arg);	// Optional. Called from the scrubber thread for each corrupted file, with a NULL name for corrupted metadata.
+	void *scrubReportArg;	// Argument passed to scrubReport.
+	int maxOpenFiles;	// Size of the pool of file descriptors, independent of the number of files. openFile fails with -2 when all are in use. Default 16.
+}FSMountOptions;
+
+/* Counters of the background scrubber, as returned by getScrubStats */
+typedef struct{
+	long passes;		// Complete passes over the metadata and all the files
+	long blocksVerified;	// Data blocks read and verified
+	long corruptFiles;	// Corrupted files found (quarantined if scrubQuarantine is set)
+	long metadataErrors;	// Passes in which the metadata CRC did not match
+}FSScrubStats;
+
+/* Block buffer allocation counters, as returned by getAllocStats */
+typedef struct{
+	long bufferRequests;	// Block buffers requested by file system operations since the mount
+	long heapAllocations;	// Requests not served by the per-mount pool, which allocated memory from the heap
+	int poolBuffers;	// Number of buffers in the per-mount pool
+	int buffersInUse;	// Pool buffers currently in use
+}FSAllocStats;
+
+/* Attributes of a file, as returned by statFile and listFiles */
+typedef struct{
+	const char *name;	// Name of the file. Valid until the file is removed, another file is created or the file system unmounted.
+	int size;		// Size of the file, in bytes
+	int written;		// 1 if the data block of the file has ever been written, 0 otherwise
+}FileStat;
 
 
 /*
@@ -25,12 +74,24 @@
  * @return 	0 if success, -1 otherwise.
  */
 int mkFS(long deviceSize);
+
+/*
+ * @brief 	Generates the file system structure in a storage device with the given format options.
+ * @return 	0 if success, -1 otherwise.
+ */
+int mkFSOptions(long deviceSize, const FSOptions *options);
 /*
  * @brief 	Mounts a file system in the simulated device.
  * @return 	0 if success, -1 otherwise.
  */
 int mountFS(void);
 
+/*
+ * @brief 	Mounts a file system in the simulated device with the given mount options.
+ * @return 	0 if success, -1 otherwise.
+ */
+int mountFSOptions(const FSMountOptions *options);
+
 /*
  * @brief 	Unmounts the file system from the simulated device.
  * @return 	0 if success, -1 otherwise.
@@ -38,7 +99,7 @@ int mountFS(void);
 int unmountFS(void);
 
 /*
- * @brief	Creates a new file, provided it it doesn't exist in the file system.
+ * @brief	Creates a new file, provided it it doesn't exist in the file system. Names can be up to 255 characters long.
  * @return	0 if success, -1 if the file already exists, -2 in case of error.
  */
 int createFile(char *fileName);
@@ -49,6 +110,28 @@ int createFile(char *fileName);
  */
 int removeFile(char *fileName);
 
+/*
+ * @brief	Creates several files at once. Each result is stored in <results> with the same meaning
+ * 		as the return value of createFile. The metadata is written to disk once for the whole batch.
+ * @return	Number of files created, -2 in case of error (no file is created).
+ */
+int createFiles(char **fileNames, int numFiles, int *results);
+
+/*
+ * @brief	Deletes several files at once. Each result is stored in <results> with the same meaning
+ * 		as the return value of removeFile. The metadata is written to disk once for the whole batch.
+ * @return	Number of files deleted, -2 in case of error (no file is deleted).
+ */
+int removeFiles(char **fileNames, int numFiles, int *results);
+
+/*
+ * @brief	Replaces the whole contents of an existing, closed file with the <length> bytes of <buffer>.
+ * 		The new contents are written to a free block and the file is switched to it with a single
+ * 		metadata update, so after a crash the file has either its old or its new contents.
+ * @return	0 if success, -1 if the file does not exist, -2 in case of error.
+ */
+int replaceFile(char *fileName, void *buffer, int length);
+
 /*
  * @brief	Opens an existing file.
  * @return	The file descriptor if possible, -1 if file does not exist, -2 in case of error..
@@ -61,6 +144,30 @@ int openFile(char *fileName);
  */
 int closeFile(int fileDescriptor);
 
+/*
+ * @brief	Makes the data and metadata of an open file durable on the device.
+ * @return	0 if success, -1 otherwise.
+ */
+int syncFile(int fileDescriptor);
+
+/*
+ * @brief	Makes the data and metadata of every file durable on the device.
+ * @return	0 if success, -1 otherwise.
+ */
+int syncFS(void);
+
+/*
+ * @brief	Gets the block buffer allocation counters since the file system was mounted.
+ * @return	0 if success, -1 otherwise.
+ */
+int getAllocStats(FSAllocStats *stats);
+
+/*
+ * @brief	Gets the counters of the background scrubber since the file system was mounted.
+ * @return	0 if success, -1 if the scrubber is not running.
+ */
+int getScrubStats(FSScrubStats *stats);
+
 /*
  * @brief	Reads a number of bytes from a file and stores them in a buffer.
  * @return	Number of bytes properly read, -1 in case of error.
@@ -91,4 +198,32 @@ int checkFS(void);
  */
 int checkFile(char *fileName);
 
+/*
+ * @brief	Obtains the attributes of a file without opening it or accessing the device.
+ * @return	0 if success, -1 if the file does not exist, -2 in case of error.
+ */
+int statFile(char *fileName, FileStat *info);
+
+/*
+ * @brief	Calls <callback> with the attributes of every file whose name starts with <prefix>, in name order.
+ * 		A NULL or empty prefix lists every file. Listing stops if the callback returns a value other than 0.
+ * 		The callback must not create or remove files. No device access is performed.
+ * @return	Number of files passed to the callback, -1 in case of error.
+ */
+int listFiles(char *prefix, int (*callback)(const FileStat *info, void *arg), void *arg);
+
+/*
+ * @brief	Maps the contents of an open file for read-only access without copying them.
+ * 		The CRC of the file is verified once, when it is mapped. The pointer stays valid until
+ * 		unmapFile or closeFile is called on the descriptor.
+ * @return	Pointer to the file contents and its size in <length>, NULL in case of error.
+ */
+const void *mapFile(int fileDescriptor, int *length);
+
+/*
+ * @brief	Releases a mapping obtained with mapFile.
+ * @return	0 if success, -1 otherwise.
+ */
+int unmapFile(int fileDescriptor);
+
 #endif
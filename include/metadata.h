@@ -7,21 +7,43 @@
  */
 #include <stdint.h>
 #define MAX_FILE 64 				// Número máximo de ficheros que puede gestionar el sistema
+#define MAX_BLOQUES_DATOS 128			// Número máximo de bloques de datos que puede gestionar el sistema. Es independiente del número de Inodos.
+#define MAX_TAM_BLOQUE 65536			// Tamaño máximo de bloque que se puede elegir al formatear. El mínimo es BLOCK_SIZE.
+#define NUM_SECTORES_CRC 4			// Número de sectores en los que se divide cada bloque de datos para calcular su CRC (sectores de 512 bytes con bloques de 2048 bytes)
+#define MAX_DISPOSITIVOS 8			// Número máximo de imágenes entre las que se pueden repartir los bloques de datos (striping)
+#define MAX_LONGITUD_NOMBRE 255			// Longitud máxima del nombre de un fichero, sin contar el carácter de fin de cadena
+#define LONGITUD_MEDIA_NOMBRE 16		// Bytes del montón de nombres que se reservan por Inodo al formatear. Si no caben en el primer bloque se añade un segundo bloque de metadatos.
+#define MAX_MONTON_NOMBRES (MAX_FILE*(MAX_LONGITUD_NOMBRE+1))	// Capacidad máxima del montón de nombres: todos los ficheros con el nombre más largo posible
 
 typedef struct{
 	uint8_t numInodos;
-}SuperBloque;			// Esctructura superbloque. Sólo almacena el número de Inodos del sistema de ficheros.
+	uint8_t bloquesIniciados;	// Marca de agua: número de bloques de metadatos (desde el bloque 0) que ya se han escrito en disco. Los bloques posteriores se consideran a ceros.
+	uint8_t sectoresBloque;		// Número de bloques del dispositivo (de BLOCK_SIZE bytes) que forman un bloque del sistema de ficheros.
+	uint8_t numDispositivos;	// Número de imágenes entre las que se reparten los bloques de datos, uno en cada una por turnos (RAID-0).
+	uint8_t indiceDispositivo;	// Posición de la imagen que contiene este superbloque dentro del conjunto. La imagen 0 contiene los metadatos.
+	uint8_t desmontadoLimpio;	// 1 si el sistema de ficheros se desmontó correctamente (o no se ha montado desde que se formateó). Se pone a 0 al montar.
+	uint8_t bloquesMetadatos;	// Número de bloques de metadatos (1 o 2). Todos los Inodos están en el primero; el montón de nombres ocupa el resto del primero y, si hace falta, el segundo.
+	uint8_t numBloquesDatos;	// Número de bloques de datos. Se elige al formatear por separado del número de Inodos.
+	uint8_t modoRegistro;		// 1 si los bloques de datos se escriben en modo registro (log-structured): cada escritura va a un bloque nuevo en la cabeza del registro.
+	uint8_t cabezaRegistro;		// Cabeza del registro: siguiente bloque de datos (relativo al primer bloque de datos) en el que se escribe en modo registro.
+	uint16_t finMontonNombres;	// Bytes ocupados del montón de nombres. Los nombres nuevos se añaden a partir de esta posición.
+	uint32_t identificador;		// Identificador del sistema de ficheros, común a todas sus imágenes. Permite comprobar al montar que pertenecen al mismo conjunto.
+}SuperBloque;			// Esctructura superbloque. Almacena el número de Inodos y de bloques de datos del sistema de ficheros, cuántos bloques de Inodos están inicializados, el tamaño de bloque, el reparto entre imágenes y el uso del montón de nombres.
 
 
 typedef struct{
-	char nombre[32];	// Nombre del fichero
-	uint16_t tamanyo;	// Tamaño del fichero
-	uint16_t CRCdatos;	// CRC del bloque de datos que identifica el iNodo
-}Inodo;				// Estrcutura Inodo. Cada fichero tiene asociado un Inodo que almacena información sobre él.
+	uint32_t tamanyo;	// Tamaño del fichero. Puede ser igual al tamaño de bloque, que llega a MAX_TAM_BLOQUE (65536), por lo que no cabe en 16 bits.
+	uint16_t CRCsectores[NUM_SECTORES_CRC];	// CRC de cada sector del bloque de datos que identifica el iNodo
+	uint16_t nombre;	// Posición del nombre del fichero (terminado en '\0') dentro del montón de nombres
+	uint8_t sinEscribir;	// 1 si el fichero nunca se ha escrito (su contenido se considera ceros y no tiene bloque de datos asignado), 0 en caso contrario
+	uint8_t bloqueDatos;	// Bloque de datos asignado al fichero, relativo al primer bloque de datos del disco. Sólo es válido si sinEscribir es 0.
+}Inodo;				// Estrcutura Inodo. Cada fichero tiene asociado un Inodo que almacena información sobre él. Es de tamaño fijo y pequeño: el nombre se guarda aparte, en el montón de nombres.
 
 /* Declaración de las variables */
 SuperBloque s_bloque;
 char mapaInodos[64];		// Mapa de Inodos. Indica qué Inodos están siendo utilizados. Cada posición del array toma valor 0 (Inodo libre) o 1(Inodo ocupado).
+char mapaBloques[MAX_BLOQUES_DATOS];	// Mapa de bloques de datos. Cada posición (relativa al primer bloque de datos) toma valor 0 (bloque libre) o 1 (bloque asignado a un fichero).
 Inodo* ArrayInodos;		// Array de estructuras Inodo.
+char* montonNombres;		// Montón de nombres. Guarda seguidos los nombres de los ficheros, cada uno terminado en '\0'. Los Inodos apuntan a su nombre dentro de él.
 uint16_t CRCmetadata;		// CRC de los metadatos para comprobaciones de integridad.
 
@@ -0,0 +1,65 @@
+/*
+ * OPERATING SYSTEMS DESING - 16/17
+ *
+ * @file 	protocol.h
+ * @brief 	Binary protocol between the file system server (server.c) and its clients (client.c).
+ * @date	01/03/2017
+ */
+
+#ifndef _PROTOCOL_H_
+#define _PROTOCOL_H_
+
+#include <stdint.h>
+
+#define FS_SOCKET "filesystem.sock"		// Socket Unix por defecto en el que escucha el servidor
+#define MAX_DATOS_PETICION (128*1024)		// Número máximo de bytes de datos que acompañan a una petición o a una respuesta en el socket
+#define TAM_MEMORIA_COMPARTIDA (1024*1024)	// Tamaño de la memoria compartida de cada cliente para las lecturas y escrituras grandes
+#define UMBRAL_MEMORIA_COMPARTIDA 4096		// Las lecturas y escrituras de al menos este número de bytes se transfieren por la memoria compartida
+
+/* Operaciones del protocolo. Cada una se corresponde con una función de filesystem.h. */
+#define OP_CONECTAR 1			// Entrega al servidor la memoria compartida del cliente (descriptor enviado con SCM_RIGHTS)
+#define OP_CREAR 2			// createFile
+#define OP_BORRAR 3			// removeFile
+#define OP_CREAR_LOTE 4			// createFiles
+#define OP_BORRAR_LOTE 5		// removeFiles
+#define OP_REEMPLAZAR 6			// replaceFile
+#define OP_ABRIR 7			// openFile
+#define OP_CERRAR 8			// closeFile
+#define OP_SINCRONIZAR 9		// syncFile
+#define OP_SINCRONIZAR_TODO 10		// syncFS
+#define OP_LEER 11			// readFile
+#define OP_ESCRIBIR 12			// writeFile
+#define OP_POSICIONAR 13		// lseekFile
+#define OP_COMPROBAR_FS 14		// checkFS
+#define OP_COMPROBAR 15			// checkFile
+#define OP_ESTADO 16			// statFile
+#define OP_LISTAR 17			// listFiles
+#define OP_ESTADISTICAS_RESERVA 18	// getAllocStats
+#define OP_ESTADISTICAS_VERIFICACION 19	// getScrubStats
+
+typedef struct{
+	uint32_t id;			// Identificador de la petición elegido por el cliente. La respuesta lleva el mismo.
+	uint8_t operacion;		// Una de las operaciones OP_*
+	uint8_t compartida;		// 1 si los datos que se escriben (o los que se leen) están en la memoria compartida en vez de en el socket
+	uint16_t reservado;
+	int32_t descriptor;		// Descriptor de fichero. En los lotes, número de ficheros.
+	int32_t parametro;		// Número de bytes a leer o a escribir en la memoria compartida, whence de lseekFile o tamaño de la memoria compartida
+	int64_t desplazamiento;		// offset de lseekFile
+	uint32_t longitudDatos;		// Número de bytes de datos que siguen a la cabecera en el socket (nombre y, si no se usa la memoria compartida, contenido)
+	uint32_t posicionCompartida;	// Posición de los datos dentro de la memoria compartida (si compartida es 1)
+}Peticion;			// Cabecera de cada petición. Los nombres de fichero se envían como datos, terminados en '\0'.
+
+typedef struct{
+	uint32_t id;			// Identificador de la petición a la que responde
+	int32_t resultado;		// Valor devuelto por la función de filesystem.h
+	uint8_t compartida;		// 1 si los datos leídos se han dejado en la memoria compartida, en la posición indicada en la petición
+	uint8_t reservado[3];
+	uint32_t longitudDatos;		// Número de bytes de datos que siguen a la cabecera en el socket
+}Respuesta;			// Cabecera de cada respuesta. El servidor responde a las peticiones de cada cliente en el orden en que llegan.
+
+typedef struct{
+	int32_t tamanyo;		// Tamaño del fichero
+	int32_t escrito;		// 1 si el bloque de datos del fichero se ha escrito alguna vez
+}AtributosFichero;		// Atributos de un fichero en las respuestas de statFile y listFiles, seguidos de su nombre terminado en '\0'.
+
+#endif
@@ -0,0 +1,551 @@
+/*
+ * OPERATING SYSTEMS DESING - 16/17
+ *
+ * @file 	server.c
+ * @brief 	File system server. Mounts the file system and serves the operations of filesystem.h to several local processes
+ * 		through a Unix domain socket, using the protocol of protocol.h.
+ * @date	01/03/2017
+ */
+
+#define _GNU_SOURCE
+#include "include/filesystem.h"		// Headers for the core functionality
+#include "include/protocol.h"		// Protocol between the server and its clients
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#define MAX_CLIENTES 64			// Número máximo de procesos cliente conectados a la vez
+
+typedef struct{
+	int socket;		// Socket del cliente. -1 si la entrada está libre.
+	char* entrada;		// Datos recibidos del cliente que aún no forman una petición completa
+	int numEntrada;		// Número de bytes en entrada
+	char* salida;		// Respuestas pendientes de enviar al cliente
+	int numSalida;		// Número de bytes en salida
+	int capSalida;		// Capacidad de salida
+	int enviados;		// Bytes de salida ya enviados
+	char* compartida;	// Memoria compartida del cliente proyectada en el servidor. NULL si no la ha entregado.
+	int tamCompartida;	// Tamaño de la memoria compartida
+	int descriptorRecibido;	// Descriptor recibido con SCM_RIGHTS pendiente de proyectar con OP_CONECTAR. -1 si no hay ninguno.
+	char* propios;		// propios[fd] es 1 si el descriptor de fichero fd lo ha abierto este cliente
+	int numPropios;		// Número de posiciones de propios
+}Cliente;			// Estado de cada proceso cliente conectado
+
+static Cliente clientes[MAX_CLIENTES];
+static volatile sig_atomic_t servidorActivo= 1;
+static char bufferDatos[MAX_DATOS_PETICION];	// Buffer de las lecturas y de los datos de las respuestas que no van por la memoria compartida
+
+/*
+ * @brief 	Manejador de SIGINT y SIGTERM: detiene el bucle del servidor para desmontar el sistema de ficheros.
+ */
+static void stopServer(int senyal){
+	(void) senyal;
+	servidorActivo= 0;
+}
+
+/*
+ * @brief 	Añade una respuesta a las pendientes de enviar al cliente.
+ * @return 	0 si se ejecuta con éxito, -1 si no hay memoria.
+ */
+static int addResponse(Cliente* cliente, uint32_t id, int resultado, int compartida, const void* datos, int longitud){
+	int necesario= cliente->numSalida+sizeof(Respuesta)+longitud;
+	if(necesario>cliente->capSalida){
+		int capacidad= cliente->capSalida>0 ? cliente->capSalida : 4096;
+		while(capacidad<necesario){
+			capacidad*= 2;
+		}
+		char* salida= (char*) realloc(cliente->salida, capacidad);
+		if(salida==NULL){
+			return -1;
+		}
+		cliente->salida= salida;
+		cliente->capSalida= capacidad;
+	}
+	Respuesta respuesta;
+	memset(&respuesta, 0, sizeof(respuesta));
+	respuesta.id= id;
+	respuesta.resultado= resultado;
+	respuesta.compartida= compartida;
+	respuesta.longitudDatos= longitud;
+	memcpy(cliente->salida+cliente->numSalida, &respuesta, sizeof(respuesta));
+	if(longitud>0){
+		memcpy(cliente->salida+cliente->numSalida+sizeof(respuesta), datos, longitud);
+	}
+	cliente->numSalida= necesario;
+	return 0;
+}
+
+/*
+ * @brief 	Marca el descriptor de fichero fd como abierto (valor 1) o cerrado (valor 0) por el cliente.
+ * @return 	0 si se ejecuta con éxito, -1 si no hay memoria.
+ */
+static int setOwner(Cliente* cliente, int fd, int valor){
+	if(fd>=cliente->numPropios){
+		int numPropios= fd+16;
+		char* propios= (char*) realloc(cliente->propios, numPropios);
+		if(propios==NULL){
+			return -1;
+		}
+		memset(propios+cliente->numPropios, 0, numPropios-cliente->numPropios);
+		cliente->propios= propios;
+		cliente->numPropios= numPropios;
+	}
+	cliente->propios[fd]= valor;
+	return 0;
+}
+
+/*
+ * @brief 	Comprueba que el descriptor de fichero fd lo ha abierto el cliente, para que un proceso no pueda usar los ficheros de otro.
+ * @return 	1 si es del cliente, 0 si no.
+ */
+static int ownsDescriptor(Cliente* cliente, int fd){
+	return fd>=0 && fd<cliente->numPropios && cliente->propios[fd];
+}
+
+/*
+ * @brief 	Obtiene el nombre de fichero que encabeza los datos de una petición.
+ * @return 	El nombre, NULL si los datos no contienen una cadena terminada en '\0'.
+ */
+static char* getRequestName(Peticion* peticion, char* datos){
+	if(peticion->longitudDatos==0 || memchr(datos, '\0', peticion->longitudDatos)==NULL){
+		return NULL;
+	}
+	return datos;
+}
+
+/*
+ * @brief 	Comprueba que la memoria compartida entregada por un cliente no se puede reducir y tiene al menos tamanyo bytes.
+ * @return 	1 si se puede proyectar, 0 si no.
+ */
+static int isSealedMemory(int fd, int tamanyo){
+	struct stat informacion;
+	int sellos= fcntl(fd, F_GET_SEALS);
+	return sellos>=0 && (sellos & F_SEAL_SHRINK) && fstat(fd, &informacion)==0 && informacion.st_size>=tamanyo;
+}
+
+/*
+ * @brief 	Obtiene los longitud bytes de la memoria compartida del cliente a partir de la posición indicada en la petición.
+ * @return 	Puntero a los datos, NULL si el cliente no tiene memoria compartida o el rango no está dentro de ella.
+ */
+static char* getSharedData(Cliente* cliente, Peticion* peticion, int longitud){
+	if(cliente->compartida==NULL || longitud<0 || peticion->posicionCompartida>(uint32_t) cliente->tamCompartida ||
+		(uint32_t) longitud>cliente->tamCompartida-peticion->posicionCompartida){
+		return NULL;
+	}
+	return cliente->compartida+peticion->posicionCompartida;
+}
+
+/*
+ * @brief 	Ejecuta las operaciones de lote (createFiles y removeFiles). Los datos son los nombres de los ficheros, uno tras otro y
+ * 		terminados en '\0', y la respuesta lleva el resultado de cada uno.
+ * @return 	0 si se ejecuta con éxito, -1 si no hay memoria para la respuesta.
+ */
+static int processBatch(Cliente* cliente, Peticion* peticion, char* datos){
+	int numFicheros= peticion->descriptor;
+	if(numFicheros<0 || numFicheros>(int) (sizeof(bufferDatos)/sizeof(int32_t))){
+		return addResponse(cliente, peticion->id, -2, 0, NULL, 0);
+	}
+	char** nombres= (char**) malloc(sizeof(char*)*(numFicheros>0 ? numFicheros : 1));
+	int* resultados= (int*) malloc(sizeof(int)*(numFicheros>0 ? numFicheros : 1));
+	if(nombres==NULL || resultados==NULL){
+		free(nombres);
+		free(resultados);
+		return addResponse(cliente, peticion->id, -2, 0, NULL, 0);
+	}
+
+	/* Separación de los nombres */
+	uint32_t posicion= 0;
+	int i;
+	for(i=0; i<numFicheros; i++){
+		char* fin= posicion<peticion->longitudDatos ? memchr(datos+posicion, '\0', peticion->longitudDatos-posicion) : NULL;
+		if(fin==NULL){
+			free(nombres);
+			free(resultados);
+			return addResponse(cliente, peticion->id, -2, 0, NULL, 0);
+		}
+		nombres[i]= datos+posicion;
+		posicion= fin-datos+1;
+	}
+
+	int ret= peticion->operacion==OP_CREAR_LOTE ? createFiles(nombres, numFicheros, resultados) : removeFiles(nombres, numFicheros, resultados);
+	int32_t* resultadosRespuesta= (int32_t*) bufferDatos;
+	for(i=0; i<numFicheros; i++){
+		resultadosRespuesta[i]= resultados[i];
+	}
+	free(nombres);
+	free(resultados);
+	return addResponse(cliente, peticion->id, ret, 0, bufferDatos, sizeof(int32_t)*numFicheros);
+}
+
+/*
+ * @brief 	Añade al buffer de la respuesta de listFiles los atributos y el nombre de un fichero.
+ * @return 	0 para seguir listando, 1 si no caben más ficheros en la respuesta.
+ */
+static int addListedFile(const FileStat* info, void* arg){
+	int* longitud= (int*) arg;
+	int longitudNombre= strlen(info->name)+1;
+	if(*longitud+(int) sizeof(AtributosFichero)+longitudNombre>(int) sizeof(bufferDatos)){
+		return 1;
+	}
+	AtributosFichero atributos;
+	atributos.tamanyo= info->size;
+	atributos.escrito= info->written;
+	memcpy(bufferDatos+*longitud, &atributos, sizeof(atributos));
+	memcpy(bufferDatos+*longitud+sizeof(atributos), info->name, longitudNombre);
+	*longitud+= sizeof(atributos)+longitudNombre;
+	return 0;
+}
+
+/*
+ * @brief 	Ejecuta una petición del cliente sobre el sistema de ficheros montado y añade su respuesta a las pendientes de enviar.
+ * 		Las operaciones sobre descriptores sólo se permiten sobre los que ha abierto el propio cliente.
+ * @return 	0 si se ejecuta con éxito, -1 si se produce un error que obliga a desconectar al cliente.
+ */
+static int processRequest(Cliente* cliente, Peticion* peticion, char* datos){
+	char* nombre= getRequestName(peticion, datos);
+	int fd= peticion->descriptor;
+	int ret;
+	switch(peticion->operacion){
+	case OP_CONECTAR:
+		/* Proyección de la memoria compartida entregada por el cliente junto con la petición. Sólo se acepta si está sellada contra
+		   la reducción de tamaño y tiene al menos el tamaño indicado: si el cliente pudiera reducirla, los accesos del servidor a
+		   la parte perdida recibirían SIGBUS y terminarían el servidor de todos los clientes. */
+		ret= -1;
+		if(cliente->descriptorRecibido>=0 && cliente->compartida==NULL && peticion->parametro>0 && isSealedMemory(cliente->descriptorRecibido, peticion->parametro)){
+			char* memoria= mmap(NULL, peticion->parametro, PROT_READ|PROT_WRITE, MAP_SHARED, cliente->descriptorRecibido, 0);
+			if(memoria!=MAP_FAILED){
+				cliente->compartida= memoria;
+				cliente->tamCompartida= peticion->parametro;
+				ret= 0;
+			}
+		}
+		if(cliente->descriptorRecibido>=0){
+			close(cliente->descriptorRecibido);
+			cliente->descriptorRecibido= -1;
+		}
+		return addResponse(cliente, peticion->id, ret, 0, NULL, 0);
+	case OP_CREAR:
+		return addResponse(cliente, peticion->id, nombre!=NULL ? createFile(nombre) : -2, 0, NULL, 0);
+	case OP_BORRAR:
+		return addResponse(cliente, peticion->id, nombre!=NULL ? removeFile(nombre) : -2, 0, NULL, 0);
+	case OP_CREAR_LOTE:
+	case OP_BORRAR_LOTE:
+		return processBatch(cliente, peticion, datos);
+	case OP_REEMPLAZAR:
+		/* El contenido va a continuación del nombre o en la memoria compartida */
+		ret= -2;
+		if(nombre!=NULL){
+			int longitudNombre= strlen(nombre)+1;
+			char* contenido= peticion->compartida ? getSharedData(cliente, peticion, peticion->parametro) : datos+longitudNombre;
+			int longitud= peticion->compartida ? peticion->parametro : (int) peticion->longitudDatos-longitudNombre;
+			if(contenido!=NULL){
+				ret= replaceFile(nombre, contenido, longitud);
+			}
+		}
+		return addResponse(cliente, peticion->id, ret, 0, NULL, 0);
+	case OP_ABRIR:
+		ret= nombre!=NULL ? openFile(nombre) : -2;
+		if(ret>=0 && setOwner(cliente, ret, 1)<0){
+			closeFile(ret);
+			ret= -2;
+		}
+		return addResponse(cliente, peticion->id, ret, 0, NULL, 0);
+	case OP_CERRAR:
+		ret= ownsDescriptor(cliente, fd) ? closeFile(fd) : -1;
+		if(ret==0){
+			setOwner(cliente, fd, 0);
+		}
+		return addResponse(cliente, peticion->id, ret, 0, NULL, 0);
+	case OP_SINCRONIZAR:
+		return addResponse(cliente, peticion->id, ownsDescriptor(cliente, fd) ? syncFile(fd) : -1, 0, NULL, 0);
+	case OP_SINCRONIZAR_TODO:
+		return addResponse(cliente, peticion->id, syncFS(), 0, NULL, 0);
+	case OP_LEER:
+		/* Las lecturas grandes se dejan directamente en la memoria compartida; el resto se envía por el socket */
+		if(!ownsDescriptor(cliente, fd) || peticion->parametro<0){
+			return addResponse(cliente, peticion->id, -1, 0, NULL, 0);
+		}
+		if(peticion->compartida){
+			char* destino= getSharedData(cliente, peticion, peticion->parametro);
+			return addResponse(cliente, peticion->id, destino!=NULL ? readFile(fd, destino, peticion->parametro) : -1, 1, NULL, 0);
+		}
+		ret= readFile(fd, bufferDatos, peticion->parametro<(int) sizeof(bufferDatos) ? peticion->parametro : (int) sizeof(bufferDatos));
+		return addResponse(cliente, peticion->id, ret, 0, bufferDatos, ret>0 ? ret : 0);
+	case OP_ESCRIBIR:
+		if(!ownsDescriptor(cliente, fd)){
+			return addResponse(cliente, peticion->id, -1, 0, NULL, 0);
+		}
+		if(peticion->compartida){
+			char* origen= getSharedData(cliente, peticion, peticion->parametro);
+			return addResponse(cliente, peticion->id, origen!=NULL ? writeFile(fd, origen, peticion->parametro) : -1, 0, NULL, 0);
+		}
+		return addResponse(cliente, peticion->id, writeFile(fd, datos, peticion->longitudDatos), 0, NULL, 0);
+	case OP_POSICIONAR:
+		return addResponse(cliente, peticion->id, ownsDescriptor(cliente, fd) ? lseekFile(fd, peticion->parametro, peticion->desplazamiento) : -1, 0, NULL, 0);
+	case OP_COMPROBAR_FS:
+		return addResponse(cliente, peticion->id, checkFS(), 0, NULL, 0);
+	case OP_COMPROBAR:
+		return addResponse(cliente, peticion->id, nombre!=NULL ? checkFile(nombre) : -2, 0, NULL, 0);
+	case OP_ESTADO:{
+		/* Respuesta con los atributos seguidos del nombre */
+		FileStat info;
+		ret= nombre!=NULL ? statFile(nombre, &info) : -2;
+		int longitud= 0;
+		if(ret==0){
+			addListedFile(&info, &longitud);
+		}
+		return addResponse(cliente, peticion->id, ret, 0, bufferDatos, longitud);
+	}
+	case OP_LISTAR:{
+		int longitud= 0;
+		ret= listFiles(nombre, addListedFile, &longitud);
+		return addResponse(cliente, peticion->id, ret, 0, bufferDatos, longitud);
+	}
+	case OP_ESTADISTICAS_RESERVA:{
+		FSAllocStats estadisticas;
+		ret= getAllocStats(&estadisticas);
+		return addResponse(cliente, peticion->id, ret, 0, &estadisticas, ret==0 ? sizeof(estadisticas) : 0);
+	}
+	case OP_ESTADISTICAS_VERIFICACION:{
+		FSScrubStats estadisticas;
+		ret= getScrubStats(&estadisticas);
+		return addResponse(cliente, peticion->id, ret, 0, &estadisticas, ret==0 ? sizeof(estadisticas) : 0);
+	}
+	default:
+		return addResponse(cliente, peticion->id, -2, 0, NULL, 0);
+	}
+}
+
+/*
+ * @brief 	Recibe datos del cliente y ejecuta, en orden, todas las peticiones completas recibidas. Un cliente puede enviar varias
+ * 		peticiones seguidas sin esperar a sus respuestas: se procesan todas y sus respuestas se envían juntas.
+ * @return 	0 si se ejecuta con éxito, -1 si el cliente se ha desconectado o ha enviado una petición incorrecta.
+ */
+static int receiveRequests(Cliente* cliente){
+	/* Recepción con recvmsg para obtener el descriptor de la memoria compartida que acompaña a OP_CONECTAR */
+	char control[CMSG_SPACE(sizeof(int))];
+	struct iovec vector;
+	vector.iov_base= cliente->entrada+cliente->numEntrada;
+	vector.iov_len= sizeof(Peticion)+MAX_DATOS_PETICION-cliente->numEntrada;
+	struct msghdr mensaje;
+	memset(&mensaje, 0, sizeof(mensaje));
+	mensaje.msg_iov= &vector;
+	mensaje.msg_iovlen= 1;
+	mensaje.msg_control= control;
+	mensaje.msg_controllen= sizeof(control);
+	ssize_t recibidos= recvmsg(cliente->socket, &mensaje, MSG_CMSG_CLOEXEC);
+	if(recibidos<=0){
+		return recibidos<0 && (errno==EINTR || errno==EAGAIN) ? 0 : -1;
+	}
+	struct cmsghdr* cabecera= CMSG_FIRSTHDR(&mensaje);
+	if(cabecera!=NULL && cabecera->cmsg_level==SOL_SOCKET && cabecera->cmsg_type==SCM_RIGHTS){
+		if(cliente->descriptorRecibido>=0){
+			close(cliente->descriptorRecibido);
+		}
+		memcpy(&cliente->descriptorRecibido, CMSG_DATA(cabecera), sizeof(int));
+	}
+	cliente->numEntrada+= recibidos;
+
+	/* Ejecución de las peticiones completas */
+	int procesados= 0;
+	while(cliente->numEntrada-procesados>=(int) sizeof(Peticion)){
+		Peticion peticion;
+		memcpy(&peticion, cliente->entrada+procesados, sizeof(peticion));
+		if(peticion.longitudDatos>MAX_DATOS_PETICION){
+			return -1;
+		}
+		if(cliente->numEntrada-procesados<(int) (sizeof(peticion)+peticion.longitudDatos)){
+			break;
+		}
+		if(processRequest(cliente, &peticion, cliente->entrada+procesados+sizeof(peticion))<0){
+			return -1;
+		}
+		procesados+= sizeof(peticion)+peticion.longitudDatos;
+	}
+	memmove(cliente->entrada, cliente->entrada+procesados, cliente->numEntrada-procesados);
+	cliente->numEntrada-= procesados;
+	return 0;
+}
+
+/*
+ * @brief 	Envía al cliente las respuestas pendientes sin bloquear al servidor.
+ * @return 	0 si se ejecuta con éxito, -1 si el cliente se ha desconectado.
+ */
+static int sendResponses(Cliente* cliente){
+	while(cliente->enviados<cliente->numSalida){
+		ssize_t enviados= send(cliente->socket, cliente->salida+cliente->enviados, cliente->numSalida-cliente->enviados, MSG_NOSIGNAL|MSG_DONTWAIT);
+		if(enviados<0){
+			return errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR ? 0 : -1;
+		}
+		cliente->enviados+= enviados;
+	}
+	cliente->numSalida= 0;
+	cliente->enviados= 0;
+	return 0;
+}
+
+/*
+ * @brief 	Desconecta a un cliente: cierra los ficheros que dejó abiertos y libera su estado.
+ */
+static void closeClient(Cliente* cliente){
+	int fd;
+	for(fd=0; fd<cliente->numPropios; fd++){
+		if(cliente->propios[fd]){
+			closeFile(fd);
+		}
+	}
+	if(cliente->compartida!=NULL){
+		munmap(cliente->compartida, cliente->tamCompartida);
+	}
+	if(cliente->descriptorRecibido>=0){
+		close(cliente->descriptorRecibido);
+	}
+	close(cliente->socket);
+	free(cliente->entrada);
+	free(cliente->salida);
+	free(cliente->propios);
+	memset(cliente, 0, sizeof(Cliente));
+	cliente->socket= -1;
+}
+
+/*
+ * @brief 	Monta el sistema de ficheros y atiende a los clientes hasta recibir SIGINT o SIGTERM. Uso: server [-f tamaño [-b bloque]]
+ * 		[socket]. Con -f formatea antes el dispositivo con ese tamaño (y el tamaño de bloque de -b), ya que los clientes no
+ * 		pueden hacerlo.
+ * @return 	0 si se ejecuta con éxito, 1 si no se puede formatear o montar el sistema de ficheros o abrir el socket.
+ */
+int main(int argc, char** argv){
+	long tamFormato= 0;
+	FSOptions opcionesFormato;
+	memset(&opcionesFormato, 0, sizeof(opcionesFormato));
+	int opcion;
+	while((opcion= getopt(argc, argv, "f:b:"))!=-1){
+		if(opcion=='f'){
+			tamFormato= atol(optarg);
+		}
+		else if(opcion=='b'){
+			opcionesFormato.blockSize= atoi(optarg);
+		}
+		else{
+			fprintf(stderr, "usage: server [-f deviceSize [-b blockSize]] [socket]\n");
+			return 1;
+		}
+	}
+	const char* ruta= optind<argc ? argv[optind] : FS_SOCKET;
+	int i;
+
+	/* Formateo del dispositivo, si se ha pedido */
+	if(tamFormato>0 && mkFSOptions(tamFormato, &opcionesFormato)<0){
+		fprintf(stderr, "server: cannot format the device\n");
+		return 1;
+	}
+
+	/* Montaje del sistema de ficheros. Sólo el servidor accede al dispositivo. */
+	if(mountFS()<0){
+		fprintf(stderr, "server: cannot mount the file system\n");
+		return 1;
+	}
+
+	/* Apertura del socket */
+	struct sockaddr_un direccion;
+	memset(&direccion, 0, sizeof(direccion));
+	direccion.sun_family= AF_UNIX;
+	if(strlen(ruta)>=sizeof(direccion.sun_path)){
+		unmountFS();
+		return 1;
+	}
+	strcpy(direccion.sun_path, ruta);
+	int escucha= socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+	unlink(ruta);
+	if(escucha<0 || bind(escucha, (struct sockaddr*) &direccion, sizeof(direccion))<0 || listen(escucha, MAX_CLIENTES)<0){
+		fprintf(stderr, "server: cannot listen on %s\n", ruta);
+		if(escucha>=0){
+			close(escucha);
+		}
+		unmountFS();
+		return 1;
+	}
+
+	struct sigaction accion;
+	memset(&accion, 0, sizeof(accion));
+	accion.sa_handler= stopServer;
+	sigaction(SIGINT, &accion, NULL);
+	sigaction(SIGTERM, &accion, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	for(i=0; i<MAX_CLIENTES; i++){
+		clientes[i].socket= -1;
+	}
+
+	/* Bucle de atención. Las peticiones de todos los clientes se ejecutan en este hilo, una detrás de otra, por lo que el
+	   sistema de ficheros no necesita sincronizar a los clientes entre sí. */
+	struct pollfd sondeos[MAX_CLIENTES+1];
+	int indices[MAX_CLIENTES+1];
+	while(servidorActivo){
+		int numSondeos= 0;
+		sondeos[numSondeos].fd= escucha;
+		sondeos[numSondeos].events= POLLIN;
+		numSondeos++;
+		for(i=0; i<MAX_CLIENTES; i++){
+			if(clientes[i].socket<0){
+				continue;
+			}
+			/* No se leen más peticiones de un cliente hasta que recoja sus respuestas */
+			sondeos[numSondeos].fd= clientes[i].socket;
+			sondeos[numSondeos].events= clientes[i].numSalida>0 ? POLLOUT : POLLIN;
+			indices[numSondeos]= i;
+			numSondeos++;
+		}
+		if(poll(sondeos, numSondeos, -1)<0){
+			continue;
+		}
+
+		/* Nuevas conexiones */
+		if(sondeos[0].revents & POLLIN){
+			int conexion= accept4(escucha, NULL, NULL, SOCK_CLOEXEC);
+			for(i=0; conexion>=0 && i<MAX_CLIENTES && clientes[i].socket>=0; i++);
+			if(conexion>=0 && i<MAX_CLIENTES){
+				clientes[i].socket= conexion;
+				clientes[i].descriptorRecibido= -1;
+				clientes[i].entrada= (char*) malloc(sizeof(Peticion)+MAX_DATOS_PETICION);
+				if(clientes[i].entrada==NULL){
+					closeClient(&clientes[i]);
+				}
+			}
+			else if(conexion>=0){
+				close(conexion);
+			}
+		}
+
+		/* Peticiones y respuestas de los clientes */
+		int j;
+		for(j=1; j<numSondeos; j++){
+			Cliente* cliente= &clientes[indices[j]];
+			if(sondeos[j].revents & (POLLIN|POLLHUP|POLLERR)){
+				if(receiveRequests(cliente)<0 || sendResponses(cliente)<0){
+					closeClient(cliente);
+				}
+			}
+			else if((sondeos[j].revents & POLLOUT) && sendResponses(cliente)<0){
+				closeClient(cliente);
+			}
+		}
+	}
+
+	/* Desconexión de los clientes y desmontaje */
+	for(i=0; i<MAX_CLIENTES; i++){
+		if(clientes[i].socket>=0){
+			closeClient(&clientes[i]);
+		}
+	}
+	close(escucha);
+	unlink(ruta);
+	return unmountFS()<0 ? 1 : 0;
+}
@@ -8,6 +8,8 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "include/filesystem.h"
 
 
@@ -19,16 +21,114 @@
 
 #define N_BLOCKS	25						// Number of blocks in the device
 #define DEV_SIZE 	N_BLOCKS * BLOCK_SIZE	// Device size, in bytes
+#define FIRST_INODE	(16 + 64 + 128 + 2)		// Offset of the first inode in the device image: superblock, inode map, block map and metadata CRC
+#define INODE_SIZE	16						// Size of an inode in the device image
+#define UNWRITTEN_FLAG	14					// Offset of the unwritten flag inside an inode
+#define DATA_BLOCK	15						// Offset of the data block number inside an inode
+#define CLEAN_UNMOUNT	5						// Offset of the clean unmount flag in the superblock
 
 
+/* Returns the bytes of the device image actually allocated on disk, -1 in case of error */
+long allocatedBytes(void) {
+	struct stat infoImagen;
+	if(stat(DEVICE_IMAGE, &infoImagen) < 0) {
+		return -1;
+	}
+	return (long) infoImagen.st_blocks * 512;
+}
+
+/* Creates an empty device image of the given size, in bytes. Returns 0 if success, -1 otherwise */
+int createImage(const char *name, long size) {
+	FILE *imagen = fopen(name, "w");
+	if(imagen == NULL) {
+		return -1;
+	}
+	if(fseek(imagen, size - 1, SEEK_SET) != 0 || fputc(0, imagen) == EOF) {
+		fclose(imagen);
+		return -1;
+	}
+	return fclose(imagen);
+}
+
+/* Overwrites one byte of a device image. Returns 0 if success, -1 otherwise */
+int patchImage(const char *name, long offset, char value) {
+	FILE *imagen = fopen(name, "r+");
+	if(imagen == NULL) {
+		return -1;
+	}
+	if(fseek(imagen, offset, SEEK_SET) != 0 || fputc(value, imagen) == EOF) {
+		fclose(imagen);
+		return -1;
+	}
+	return fclose(imagen);
+}
+
+/* Returns the offset in the device image of the first block whose first byte is the given one, -1 if there is none */
+long findBlock(const char *name, char value) {
+	char bloque[BLOCK_SIZE];
+	long posicion = -1;
+	long desplazamiento;
+	FILE *imagen = fopen(name, "r");
+	if(imagen == NULL) {
+		return -1;
+	}
+	for(desplazamiento = 0; posicion < 0 && fread(bloque, 1, BLOCK_SIZE, imagen) == BLOCK_SIZE; desplazamiento += BLOCK_SIZE) {
+		if(bloque[0] == value) {
+			posicion = desplazamiento;
+		}
+	}
+	fclose(imagen);
+	return posicion;
+}
+
+/* Callback for listFiles: counts the listed files */
+int countFiles(const FileStat *info, void *arg) {
+	(void) info;
+	(*(int *)arg)++;
+	return 0;
+}
+
 int main() {
 	int ret;
 	int descriptor1;
 	int descriptor2;
 	char buffer[4];
+	const char* mapeado;
+	int longitud;
+	char* lote[4] = {"lote_1.txt", "lote_2.txt", "practica_2.txt", "lote_1.txt"};
+	int resultados[4];
+	FileStat info;
+	FSOptions opciones = {0};
+	FSMountOptions opcionesMontaje = {0};
+	const char* imagenes[2] = {DEVICE_IMAGE, DEVICE_IMAGE};
+	FSAllocStats estadisticas;
+	FSScrubStats verificacion;
+	long reservasPrevias;
+	char nombreLargo[257];
+	char bloque[BLOCK_SIZE];
+	char* huecos[3] = {"hueco_1.txt", "hueco_2.txt", "hueco_3.txt"};
+	long ocupadoPrevio, ocupadoFormateado, ocupadoEscrito;
+	int i;
+	int numListados;
+	const char* imagenGrande[1] = {"disk_64k.dat"};
+	const char* imagenesStripe[2] = {DEVICE_IMAGE, "disk_2.dat"};
+	int enImagen[2];
+	char* secuenciales[6] = {"secuencial_1.txt", "secuencial_2.txt", "secuencial_3.txt", "secuencial_4.txt", "secuencial_5.txt", "secuencial_6.txt"};
+	char bloqueGrande[65536];
+	char lecturaGrande[65536];
 	
 
 	
+	///////
+
+	opciones.blockSize = 3000;
+	ret = mkFSOptions(DEV_SIZE, &opciones);
+	if(ret != -1) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mkFSOptions (invalid block size) ", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mkFSOptions (invalid block size) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
 	///////
 
 	ret = mkFS(DEV_SIZE);
@@ -110,6 +210,24 @@ int main() {
 	}
 	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST readFile ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
 
+	///////
+
+	mapeado= mapFile(descriptor1, &longitud);
+	if(mapeado == NULL || longitud != 4 || memcmp(mapeado, "Luis", 4) != 0 || unmapFile(descriptor1) != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mapFile", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mapFile ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	ret= readFile(descriptor2, &(buffer), 4);
+	if(ret != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST readFile (empty)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST readFile (empty) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
 	///////
 	
 	ret = closeFile(descriptor2);
@@ -128,6 +246,24 @@ int main() {
 	}
 	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST removeFile ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
 
+	///////
+
+	ret = createFiles(lote, 4, resultados);
+	if(ret != 2 || resultados[0] != 0 || resultados[1] != 0 || resultados[2] != -1 || resultados[3] != -1) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST createFiles", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST createFiles ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	ret = removeFiles(lote, 4, resultados);
+	if(ret != 2 || resultados[0] != 0 || resultados[1] != 0 || resultados[2] != -2 || resultados[3] != -1) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST removeFiles", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST removeFiles ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
 	///////
 	
 	ret = closeFile(descriptor1);
@@ -166,6 +302,15 @@ int main() {
 	
 	///////
 
+	descriptor2 = openFile("practica_2.txt");
+	if(descriptor2 < 0 || descriptor2 == descriptor1 || readFile(descriptor2, &(buffer), 4) != 4 || readFile(descriptor1, &(buffer), 2) != 2 || closeFile(descriptor2) != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST openFile (shared)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST openFile (shared) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
 	ret = closeFile(descriptor1);
 	if(ret != 0) {
 		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST closeFile", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
@@ -191,6 +336,421 @@ int main() {
 	}
 	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST checkFile ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
 
+	///////
+
+	ret = replaceFile("practica_2.txt", "Luis Alfredo", 12);
+	if(ret != 0 || checkFile("practica_2.txt") != 0 || replaceFile("no_existe.txt", "", 0) != -1) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST replaceFile", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST replaceFile ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	ret = statFile("practica_2.txt", &info);
+	if(ret != 0 || info.size != 12 || !info.written || strcmp(info.name, "practica_2.txt") != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST statFile", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST statFile ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	numListados = 0;
+	ret = listFiles("practica", countFiles, &numListados);
+	if(ret != 1 || numListados != 1 || listFiles("lote", countFiles, &numListados) != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST listFiles", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST listFiles ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	getAllocStats(&estadisticas);
+	reservasPrevias = estadisticas.heapAllocations;
+	descriptor1 = openFile("practica_2.txt");
+	ret = writeFile(descriptor1, "Luis", 4);
+	lseekFile(descriptor1, FS_SEEK_BEGIN, 0);
+	ret += readFile(descriptor1, buffer, 4);
+	ret += closeFile(descriptor1);
+	if(ret != 8 || getAllocStats(&estadisticas) != 0 || estadisticas.heapAllocations != reservasPrevias || estadisticas.buffersInUse != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST getAllocStats", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST getAllocStats ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	ret = getScrubStats(&verificacion);
+	if(ret != -1) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST getScrubStats (no scrubber)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST getScrubStats (no scrubber) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	ret = syncFS();
+	if(ret != 0 || syncFile(descriptor1) != -1) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST syncFS", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST syncFS ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	opcionesMontaje.devices = imagenes;
+	opcionesMontaje.numDevices = 2;
+	ret = unmountFS();
+	if(ret != 0 || mountFSOptions(&opcionesMontaje) != -1) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mountFSOptions (wrong devices)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mountFSOptions (wrong devices) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	ret = mountFS();
+	descriptor1 = openFile("practica_2.txt");
+	if(ret != 0 || descriptor1 < 0 || closeFile(descriptor1) != 0 || unmountFS() != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mountFS (clean remount)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mountFS (clean remount) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	opciones.blockSize = 0;
+	opciones.numInodes = 2;
+	ret = mkFSOptions(DEV_SIZE, &opciones);
+	ret += mountFS();
+	ret += createFile("inodo_1.txt");
+	ret += createFile("inodo_2.txt");
+	if(ret != 0 || createFile("inodo_3.txt") != -2 || unmountFS() != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mkFSOptions (numInodes)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mkFSOptions (numInodes) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	opciones.numInodes = 0;
+	opciones.logStructured = 1;
+	ret = mkFSOptions(DEV_SIZE, &opciones);
+	ret += mountFS();
+	ret += createFile("registro.txt");
+	descriptor1 = openFile("registro.txt");
+	ret += writeFile(descriptor1, "Luis", 4) - 4;
+	lseekFile(descriptor1, FS_SEEK_BEGIN, 0);
+	ret += writeFile(descriptor1, "Ana", 3) - 3;
+	ret += closeFile(descriptor1);
+	ret += unmountFS();
+	ret += mountFS();
+	descriptor1 = openFile("registro.txt");
+	ret += readFile(descriptor1, buffer, 4) - 4;
+	ret += closeFile(descriptor1);
+	if(ret != 0 || strncmp(buffer, "Anas", 4) != 0 || checkFile("registro.txt") != 0 || unmountFS() != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mkFSOptions (logStructured)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mkFSOptions (logStructured) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	opcionesMontaje.devices = NULL;
+	opcionesMontaje.numDevices = 0;
+	opcionesMontaje.maxOpenFiles = 1;
+	ret = mountFSOptions(&opcionesMontaje);
+	descriptor1 = openFile("registro.txt");
+	descriptor2 = openFile("registro.txt");
+	if(ret != 0 || descriptor1 != 0 || descriptor2 != -2 || closeFile(descriptor1) != 0 || unmountFS() != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mountFSOptions (maxOpenFiles)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mountFSOptions (maxOpenFiles) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	memset(nombreLargo, 'n', 256);
+	nombreLargo[256] = '\0';
+	ret = mountFS();
+	ret += createFile(nombreLargo) + 2;
+	nombreLargo[200] = '\0';
+	ret += createFile(nombreLargo);
+	descriptor1 = openFile(nombreLargo);
+	ret += writeFile(descriptor1, "Luis", 4) - 4;
+	ret += closeFile(descriptor1);
+	ret += unmountFS();
+	ret += mountFS();
+	descriptor1 = openFile(nombreLargo);
+	ret += readFile(descriptor1, buffer, 4) - 4;
+	ret += closeFile(descriptor1);
+	if(ret != 0 || strncmp(buffer, "Luis", 4) != 0 || statFile(nombreLargo, &info) != 0 || strcmp(info.name, nombreLargo) != 0 || checkFile(nombreLargo) != 0 || unmountFS() != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST createFile (long name)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST createFile (long name) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	memset(bloque, 'h', BLOCK_SIZE);
+	ocupadoPrevio = allocatedBytes();
+	ret = mkFS(DEV_SIZE);
+	ocupadoFormateado = allocatedBytes();
+	ret += mountFS();
+	for(i = 0; i < 3; i++) {
+		ret += createFile(huecos[i]);
+		descriptor1 = openFile(huecos[i]);
+		ret += writeFile(descriptor1, bloque, BLOCK_SIZE) - BLOCK_SIZE;
+		ret += closeFile(descriptor1);
+	}
+	ret += unmountFS();
+	ocupadoEscrito = allocatedBytes();
+	ret += mountFS();
+	for(i = 0; i < 3; i++) {
+		ret += removeFile(huecos[i]);
+	}
+	ret += unmountFS();
+	if(ret != 0 || ocupadoFormateado >= ocupadoPrevio || ocupadoEscrito <= ocupadoFormateado || allocatedBytes() >= ocupadoEscrito) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST removeFile (hole punching)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST removeFile (hole punching) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	memset(bloqueGrande, 'g', 65536);
+	memset(lecturaGrande, 0, 65536);
+	opciones.blockSize = 65536;
+	opciones.devices = imagenGrande;
+	opciones.numDevices = 1;
+	opciones.numInodes = 0;
+	opciones.logStructured = 0;
+	opcionesMontaje.devices = imagenGrande;
+	opcionesMontaje.numDevices = 1;
+	opcionesMontaje.maxOpenFiles = 0;
+	ret = createImage("disk_64k.dat", 3 * 65536);
+	ret += mkFSOptions(3 * 65536, &opciones);
+	ret += mountFSOptions(&opcionesMontaje);
+	ret += createFile("grande.txt");
+	descriptor1 = openFile("grande.txt");
+	ret += writeFile(descriptor1, bloqueGrande, 65536) - 65536;
+	ret += closeFile(descriptor1);
+	ret += unmountFS();
+	ret += mountFSOptions(&opcionesMontaje);
+	ret += statFile("grande.txt", &info) + info.size - 65536;
+	descriptor1 = openFile("grande.txt");
+	ret += readFile(descriptor1, lecturaGrande, 65536) - 65536;
+	ret += closeFile(descriptor1);
+	ret += memcmp(bloqueGrande, lecturaGrande, 65536) != 0;
+	bloqueGrande[0] = 'r';
+	ret += replaceFile("grande.txt", bloqueGrande, 65536);
+	ret += statFile("grande.txt", &info) + info.size - 65536;
+	descriptor1 = openFile("grande.txt");
+	ret += readFile(descriptor1, lecturaGrande, 65536) - 65536;
+	ret += closeFile(descriptor1);
+	ret += memcmp(bloqueGrande, lecturaGrande, 65536) != 0;
+	if(ret != 0 || checkFile("grande.txt") != 0 || unmountFS() != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mkFSOptions (blockSize 65536)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	remove("disk_64k.dat");
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mkFSOptions (blockSize 65536) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	/* The file is written and then its inode is marked as unwritten in the image: its data block still holds "Luis", so
+	   reading zeros shows that the block is not read from the device */
+	ret = mkFS(DEV_SIZE);
+	ret += mountFS();
+	ret += createFile("sin_escribir.txt");
+	descriptor1 = openFile("sin_escribir.txt");
+	ret += writeFile(descriptor1, "Luis", 4) - 4;
+	ret += closeFile(descriptor1);
+	ret += unmountFS();
+	ret += patchImage(DEVICE_IMAGE, FIRST_INODE + UNWRITTEN_FLAG, 1);
+	ret += mountFS();
+	ret += statFile("sin_escribir.txt", &info) + info.size - 4 + info.written;
+	descriptor1 = openFile("sin_escribir.txt");
+	memset(buffer, 'x', 4);
+	ret += readFile(descriptor1, buffer, 4) - 4;
+	ret += closeFile(descriptor1);
+	if(ret != 0 || memcmp(buffer, "\0\0\0\0", 4) != 0 || unmountFS() != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST readFile (unwritten)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST readFile (unwritten) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	/* One byte of the second sector of the data block of corrupto.txt is changed in the image */
+	ret = mkFS(DEV_SIZE);
+	ret += mountFS();
+	ret += createFile("corrupto.txt");
+	ret += createFile("correcto.txt");
+	memset(bloque, 'c', BLOCK_SIZE);
+	ret += replaceFile("corrupto.txt", bloque, BLOCK_SIZE);
+	memset(bloque, 'l', BLOCK_SIZE);
+	ret += replaceFile("correcto.txt", bloque, BLOCK_SIZE);
+	ret += unmountFS();
+	ret += findBlock(DEVICE_IMAGE, 'c') > 0 ? 0 : -1;
+	ret += patchImage(DEVICE_IMAGE, findBlock(DEVICE_IMAGE, 'c') + BLOCK_SIZE / 4 + 1, 'x');
+	ret += mountFS();
+	if(ret != 0 || checkFile("corrupto.txt") != -1 || checkFile("correcto.txt") != 0 || unmountFS() != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST checkFile (corrupted sector)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST checkFile (corrupted sector) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	/* Each file is read sequentially in two halves, so the blocks of the next files are prefetched while the scan goes on */
+	ret = mkFS(DEV_SIZE);
+	ret += mountFS();
+	for(i = 0; i < 6; i++) {
+		memset(bloque, 'a' + i, BLOCK_SIZE);
+		ret += createFile(secuenciales[i]);
+		ret += replaceFile(secuenciales[i], bloque, BLOCK_SIZE);
+	}
+	ret += unmountFS();
+	ret += mountFS();
+	for(i = 0; i < 6; i++) {
+		memset(bloque, 0, BLOCK_SIZE);
+		descriptor1 = openFile(secuenciales[i]);
+		ret += readFile(descriptor1, bloque, BLOCK_SIZE / 2) - BLOCK_SIZE / 2;
+		ret += readFile(descriptor1, bloque + BLOCK_SIZE / 2, BLOCK_SIZE / 2) - BLOCK_SIZE / 2;
+		ret += closeFile(descriptor1);
+		ret += bloque[0] != 'a' + i || memcmp(bloque, bloque + 1, BLOCK_SIZE - 1) != 0;
+	}
+	if(ret != 0 || unmountFS() != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST readFile (readahead)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST readFile (readahead) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	memset(&opcionesMontaje, 0, sizeof(opcionesMontaje));
+	opcionesMontaje.directIO = 1;
+	memset(bloque, 'd', BLOCK_SIZE);
+	ret = mkFS(DEV_SIZE);
+	ret += mountFSOptions(&opcionesMontaje);
+	ret += createFile("directo.txt");
+	descriptor1 = openFile("directo.txt");
+	ret += writeFile(descriptor1, bloque, BLOCK_SIZE) - BLOCK_SIZE;
+	ret += lseekFile(descriptor1, FS_SEEK_BEGIN, 0);
+	ret += lseekFile(descriptor1, FS_SEEK_CUR, 1);
+	ret += writeFile(descriptor1, "Luis", 4) - 4;
+	ret += closeFile(descriptor1);
+	ret += unmountFS();
+	memcpy(bloque + 1, "Luis", 4);
+	memset(lecturaGrande, 0, BLOCK_SIZE);
+	ret += mountFSOptions(&opcionesMontaje);
+	descriptor1 = openFile("directo.txt");
+	ret += readFile(descriptor1, lecturaGrande, BLOCK_SIZE) - BLOCK_SIZE;
+	ret += closeFile(descriptor1);
+	if(ret != 0 || memcmp(bloque, lecturaGrande, BLOCK_SIZE) != 0 || checkFile("directo.txt") != 0 || unmountFS() != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mountFSOptions (directIO)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mountFSOptions (directIO) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	/* Consecutive data blocks go to alternate images, so two of the files must be found on each one */
+	memset(&opciones, 0, sizeof(opciones));
+	memset(&opcionesMontaje, 0, sizeof(opcionesMontaje));
+	opciones.devices = imagenesStripe;
+	opciones.numDevices = 2;
+	opcionesMontaje.devices = imagenesStripe;
+	opcionesMontaje.numDevices = 2;
+	ret = createImage("disk_2.dat", DEV_SIZE);
+	ret += mkFSOptions(DEV_SIZE, &opciones);
+	ret += mountFSOptions(&opcionesMontaje);
+	for(i = 0; i < 4; i++) {
+		memset(bloque, 'p' + i, BLOCK_SIZE);
+		ret += createFile(secuenciales[i]);
+		ret += replaceFile(secuenciales[i], bloque, BLOCK_SIZE);
+	}
+	ret += unmountFS();
+	enImagen[0] = 0;
+	enImagen[1] = 0;
+	for(i = 0; i < 4; i++) {
+		enImagen[0] += findBlock(DEVICE_IMAGE, 'p' + i) > 0;
+		enImagen[1] += findBlock("disk_2.dat", 'p' + i) > 0;
+	}
+	ret += mountFSOptions(&opcionesMontaje);
+	for(i = 0; i < 4; i++) {
+		memset(bloque, 0, BLOCK_SIZE);
+		descriptor1 = openFile(secuenciales[i]);
+		ret += readFile(descriptor1, bloque, BLOCK_SIZE) - BLOCK_SIZE;
+		ret += closeFile(descriptor1);
+		ret += bloque[0] != 'p' + i || memcmp(bloque, bloque + 1, BLOCK_SIZE - 1) != 0;
+		ret += checkFile(secuenciales[i]);
+	}
+	if(ret != 0 || enImagen[0] != 2 || enImagen[1] != 2 || unmountFS() != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mkFSOptions (2 devices)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	remove("disk_2.dat");
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mkFSOptions (2 devices) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	memset(&opcionesMontaje, 0, sizeof(opcionesMontaje));
+	opcionesMontaje.scrubRate = 1000;
+	ret = mkFS(DEV_SIZE);
+	ret += mountFS();
+	for(i = 0; i < 3; i++) {
+		memset(bloque, 's' + i, BLOCK_SIZE);
+		ret += createFile(secuenciales[i]);
+		ret += replaceFile(secuenciales[i], bloque, BLOCK_SIZE);
+	}
+	ret += unmountFS();
+	ret += mountFSOptions(&opcionesMontaje);
+	for(i = 0; i < 500 && getScrubStats(&verificacion) == 0 && verificacion.passes < 1; i++) {
+		usleep(10000);
+	}
+	ret += getScrubStats(&verificacion);
+	if(ret != 0 || verificacion.passes < 1 || verificacion.blocksVerified < 3 || verificacion.corruptFiles != 0 || verificacion.metadataErrors != 0 || unmountFS() != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST getScrubStats (scrubber)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST getScrubStats (scrubber) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	/* After a crash the second inode points to the data block of the first one: the mount must not rebuild the block map from it,
+	   even if the scrubber would verify the metadata later */
+	ret = mkFS(DEV_SIZE);
+	ret += mountFS();
+	for(i = 0; i < 2; i++) {
+		memset(bloque, 's' + i, BLOCK_SIZE);
+		ret += createFile(secuenciales[i]);
+		ret += replaceFile(secuenciales[i], bloque, BLOCK_SIZE);
+	}
+	ret += unmountFS();
+	ret += patchImage(DEVICE_IMAGE, CLEAN_UNMOUNT, 0);
+	ret += patchImage(DEVICE_IMAGE, FIRST_INODE + INODE_SIZE + DATA_BLOCK, 0);
+	if(ret != 0 || mountFSOptions(&opcionesMontaje) != -1) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mountFSOptions (unclean, corrupted inode)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST mountFSOptions (unclean, corrupted inode) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	lote[0] = "";
+	ret = mkFS(DEV_SIZE);
+	ret += mountFS();
+	ret += createFile("") + 2;
+	ret += createFiles(lote, 1, resultados) + resultados[0] + 2;
+	if(ret != 0 || listFiles(NULL, countFiles, &numListados) != 0 || unmountFS() != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST createFile (empty name)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST createFile (empty name) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
 	return 0;
 	
 }
@@ -0,0 +1,274 @@
+/*
+ * OPERATING SYSTEMS DESING - 16/17
+ *
+ * @file 	test_server.c
+ * @brief 	Implementation of the test routines of the file system server. Starts ./server on a freshly formatted device and
+ * 		shares it between two client processes linked with client.c.
+ * @date	01/03/2017
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include "include/filesystem.h"
+#include "include/client.h"
+
+
+// Color definitions for asserts
+#define ANSI_COLOR_RESET   "\x1b[0m"
+#define ANSI_COLOR_RED     "\x1b[31m"
+#define ANSI_COLOR_GREEN   "\x1b[32m"
+#define ANSI_COLOR_BLUE   "\x1b[34m"
+
+#define SERVER_BLOCK_SIZE	8192					// Block size of the device formatted by the server
+#define SERVER_DEV_SIZE 	(16 * SERVER_BLOCK_SIZE)	// Device size, in bytes
+#define SHARED_SIZE 		SERVER_BLOCK_SIZE		// Bytes of the transfers that go through the shared memory
+
+
+/* Creates an empty device image of the given size, in bytes. Returns 0 if success, -1 otherwise */
+int createImage(const char *name, long size) {
+	FILE *imagen = fopen(name, "w");
+	if(imagen == NULL) {
+		return -1;
+	}
+	if(fseek(imagen, size - 1, SEEK_SET) != 0 || fputc(0, imagen) == EOF) {
+		fclose(imagen);
+		return -1;
+	}
+	return fclose(imagen);
+}
+
+/* Starts ./server formatting the device and connects to it. Returns the pid of the server, -1 in case of error */
+pid_t startServer(void) {
+	char tamanyo[32];
+	char bloque[32];
+	snprintf(tamanyo, sizeof(tamanyo), "%d", SERVER_DEV_SIZE);
+	snprintf(bloque, sizeof(bloque), "%d", SERVER_BLOCK_SIZE);
+	unlink(FS_SOCKET);
+	pid_t servidor = fork();
+	if(servidor == 0) {
+		execl("./server", "server", "-f", tamanyo, "-b", bloque, FS_SOCKET, (char *) NULL);
+		_exit(1);
+	}
+	int intentos;
+	for(intentos = 0; servidor > 0 && intentos < 500; intentos++) {
+		if(mountFS() == 0) {
+			return servidor;
+		}
+		usleep(10000);
+	}
+	return -1;
+}
+
+/* Connects to the server without client.c and hands it a shared memory of SHARED_SIZE bytes, announcing <announced> bytes and
+   sealing it against shrinking if <seal> is 1. Returns the result of OP_CONECTAR, -2 in case of error */
+int connectRaw(int announced, int seal) {
+	struct sockaddr_un direccion;
+	memset(&direccion, 0, sizeof(direccion));
+	direccion.sun_family = AF_UNIX;
+	strcpy(direccion.sun_path, FS_SOCKET);
+	int conexion = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(conexion < 0 || connect(conexion, (struct sockaddr *) &direccion, sizeof(direccion)) < 0) {
+		close(conexion);
+		return -2;
+	}
+	int memoria = memfd_create("test_server", MFD_ALLOW_SEALING);
+	if(memoria < 0 || ftruncate(memoria, SHARED_SIZE) < 0 || (seal && fcntl(memoria, F_ADD_SEALS, F_SEAL_SHRINK) < 0)) {
+		close(memoria);
+		close(conexion);
+		return -2;
+	}
+
+	Peticion peticion;
+	memset(&peticion, 0, sizeof(peticion));
+	peticion.operacion = OP_CONECTAR;
+	peticion.parametro = announced;
+	char control[CMSG_SPACE(sizeof(int))];
+	memset(control, 0, sizeof(control));
+	struct iovec vector = {&peticion, sizeof(peticion)};
+	struct msghdr mensaje;
+	memset(&mensaje, 0, sizeof(mensaje));
+	mensaje.msg_iov = &vector;
+	mensaje.msg_iovlen = 1;
+	mensaje.msg_control = control;
+	mensaje.msg_controllen = sizeof(control);
+	struct cmsghdr *cabecera = CMSG_FIRSTHDR(&mensaje);
+	cabecera->cmsg_level = SOL_SOCKET;
+	cabecera->cmsg_type = SCM_RIGHTS;
+	cabecera->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cabecera), &memoria, sizeof(int));
+
+	Respuesta respuesta;
+	int ret = -2;
+	if(sendmsg(conexion, &mensaje, 0) == sizeof(peticion) && recv(conexion, &respuesta, sizeof(respuesta), MSG_WAITALL) == sizeof(respuesta)) {
+		ret = respuesta.resultado;
+	}
+	close(memoria);
+	close(conexion);
+	return ret;
+}
+
+/* Second client: checks that it cannot use the descriptor of the first one, opens abierto.txt and exits without closing it */
+int secondClient(int descriptorAjeno, int aviso, int espera) {
+	char buffer[4];
+	char marca = 0;
+
+	/* The connection inherited from the first client belongs to it: only the local copy is closed */
+	disconnectFS();
+	if(mountFS() != 0) {
+		return 1;
+	}
+	if(closeFile(descriptorAjeno) != -1 || readFile(descriptorAjeno, buffer, 4) != -1 || writeFile(descriptorAjeno, "Ana", 3) != -1) {
+		return 2;
+	}
+	if(openFile("abierto.txt") < 0 || write(aviso, &marca, 1) != 1 || read(espera, &marca, 1) != 1) {
+		return 3;
+	}
+	return 0;
+}
+
+int main() {
+	int ret;
+	int descriptor1;
+	char escritura[SHARED_SIZE];
+	char lectura[SHARED_SIZE];
+	char byte[1];
+	int tamCompartida;
+	int i;
+	Peticion peticion;
+	Respuesta respuesta;
+	int aviso[2];
+	int espera[2];
+	pid_t cliente;
+	int estado;
+
+	if(createImage(DEVICE_IMAGE, SERVER_DEV_SIZE) != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (start)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	pid_t servidor = startServer();
+	if(servidor < 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (start)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (start) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	for(i = 0; i < SHARED_SIZE; i++) {
+		escritura[i] = (char) (i * 7);
+	}
+	ret = createFile("compartido.txt");
+	ret += createFile("abierto.txt");
+	descriptor1 = openFile("compartido.txt");
+	ret += writeFile(descriptor1, escritura, SHARED_SIZE) - SHARED_SIZE;
+	ret += lseekFile(descriptor1, FS_SEEK_BEGIN, 0);
+	ret += readFile(descriptor1, lectura, SHARED_SIZE) - SHARED_SIZE;
+	if(ret != 0 || descriptor1 < 0 || getSharedMemory(&tamCompartida) == NULL || tamCompartida < SHARED_SIZE || memcmp(escritura, lectura, SHARED_SIZE) != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (shared memory)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		kill(servidor, SIGKILL);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (shared memory) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	ret = lseekFile(descriptor1, FS_SEEK_BEGIN, 0);
+	for(i = 0; i < 5; i++) {
+		memset(&peticion, 0, sizeof(peticion));
+		peticion.operacion = OP_LEER;
+		peticion.descriptor = descriptor1;
+		peticion.parametro = 1;
+		if(submitRequest(&peticion, NULL) < 0) {
+			ret = -1;
+		}
+	}
+	for(i = 0; i < 5; i++) {
+		if(waitResponse(&respuesta, byte, 1) != 0 || respuesta.resultado != 1 || byte[0] != escritura[i]) {
+			ret = -1;
+		}
+	}
+	if(ret != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (pipelined requests)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		kill(servidor, SIGKILL);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (pipelined requests) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	ret = pipe(aviso);
+	ret += pipe(espera);
+	fflush(stdout);
+	cliente = fork();
+	if(cliente == 0) {
+		close(aviso[0]);
+		close(espera[1]);
+		exit(secondClient(descriptor1, aviso[1], espera[0]));
+	}
+	close(aviso[1]);
+	close(espera[0]);
+	ret += read(aviso[0], byte, 1) - 1;
+	ret += checkFile("abierto.txt") + 2;
+	ret += lseekFile(descriptor1, FS_SEEK_BEGIN, 0);
+	ret += readFile(descriptor1, lectura, 4) - 4;
+	if(ret != 0 || cliente < 0 || memcmp(escritura, lectura, 4) != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (descriptor ownership)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		kill(servidor, SIGKILL);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (descriptor ownership) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	/* The server closes the descriptors of the second client when its connection is closed */
+	ret = write(espera[1], byte, 1) - 1;
+	ret += waitpid(cliente, &estado, 0) == cliente ? 0 : -1;
+	ret += WIFEXITED(estado) && WEXITSTATUS(estado) == 0 ? 0 : -1;
+	for(i = 0; i < 500 && checkFile("abierto.txt") == -2; i++) {
+		usleep(10000);
+	}
+	if(ret != 0 || checkFile("abierto.txt") != 0 || removeFile("abierto.txt") != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (close on disconnect)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		kill(servidor, SIGKILL);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (close on disconnect) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	/* The server only maps shared memory sealed against shrinking and at least as large as announced */
+	ret = connectRaw(SHARED_SIZE, 1);
+	ret += connectRaw(SHARED_SIZE, 0) + 1;
+	ret += connectRaw(2 * SHARED_SIZE, 1) + 1;
+	ret += lseekFile(descriptor1, FS_SEEK_BEGIN, 0);
+	ret += readFile(descriptor1, lectura, SHARED_SIZE) - SHARED_SIZE;
+	if(ret != 0 || memcmp(escritura, lectura, SHARED_SIZE) != 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (sealed shared memory)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		kill(servidor, SIGKILL);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (sealed shared memory) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	///////
+
+	ret = closeFile(descriptor1);
+	ret += unmountFS();
+	ret += kill(servidor, SIGTERM);
+	ret += waitpid(servidor, &estado, 0) == servidor ? 0 : -1;
+	if(ret != 0 || !WIFEXITED(estado) || WEXITSTATUS(estado) != 0 || access(FS_SOCKET, F_OK) == 0) {
+		fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (stop)", ANSI_COLOR_RED, "FAILED\n", ANSI_COLOR_RESET);
+		return -1;
+	}
+	fprintf(stdout, "%s%s%s%s%s", ANSI_COLOR_BLUE, "TEST server (stop) ", ANSI_COLOR_GREEN, "SUCCESS\n", ANSI_COLOR_RESET);
+
+	return 0;
+
+}